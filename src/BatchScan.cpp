@@ -0,0 +1,254 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <exception>
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+
+#include <BSMPT/minimizer/Minimizer.h>
+#include <BSMPT/models/ClassPotentialOrigin.h>
+#include <BSMPT/models/IncludeAllModels.h>
+
+#include "ProcessPoolScan.h"
+#include "ProgressMetrics.h"
+#include "ReferenceArchive.h"
+#include "ReferencePoint.h"
+#include "RunReport.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::exception;
+
+/**
+ * Calculates the reference values for every parameter point of the input
+ * file and streams them into a reference archive.
+ *
+ * Every non-empty line of the input file not starting with # holds the
+ * whitespace separated parameters of one point, in the order of initModel.
+ * The line number is used as point ID.
+ *
+ * Options:
+ *  --metrics-file=FILE     periodically replace FILE with the progress metrics
+ *                          in the Prometheus text format
+ *  --metrics-socket=PATH   serve the progress metrics on a Unix socket
+ *  --metrics-interval=SEC  update interval of the metrics file, default 10
+ *  --workers=N             calculate the points in N forked worker processes
+ *  --max-retries=N         retries of a task after its worker died, default 2
+ *  --task-timeout=SEC      kill workers exceeding SEC seconds for one task
+ *  --report=FILE           write timings and values for CompareRuns to FILE
+ *  --mass-temperatures=N   store the mass spectrum on N temperatures from 0 to
+ *                          Tc, default 0 (disabled)
+ *  --mass-threads=N        threads for the mass spectrum, default all cores
+ *                          or 1 per worker process with --workers
+ *  --mass-which-min=N      setting used for the mass spectrum, default
+ *                          Minimizer::WhichMinimizerDefault
+ *  --reproducible          calculate the settings independently instead of
+ *                          sharing the symmetric minimum between them
+ */
+int main(int argc, char *argv[])
+try
+{
+  std::vector<std::string> args;
+  std::map<std::string, std::string> options;
+  for (int i{1}; i < argc; ++i)
+  {
+    const std::string arg{argv[i]};
+    if (arg.compare(0, 2, "--") == 0)
+    {
+      const auto pos = arg.find('=');
+      options[arg.substr(2, pos - 2)] =
+          (pos == std::string::npos) ? "" : arg.substr(pos + 1);
+    }
+    else
+    {
+      args.push_back(arg);
+    }
+  }
+
+  if (args.size() < 3)
+  {
+    std::cerr << "Usage: " << argv[0]
+              << " Model InputFile OutputArchive [FirstLine] [LastLine]"
+              << " [--metrics-file=FILE] [--metrics-socket=PATH]"
+              << " [--metrics-interval=SEC] [--workers=N] [--max-retries=N]"
+              << " [--task-timeout=SEC] [--report=FILE]"
+              << " [--mass-temperatures=N] [--mass-threads=N]"
+              << " [--mass-which-min=N] [--reproducible]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  using namespace BSMPT;
+  using namespace ReferenceCreator;
+
+  const std::string ModelName{args.at(0)};
+  const std::string InputFileName{args.at(1)};
+  const std::string OutputFileName{args.at(2)};
+  const std::uint64_t FirstLine =
+      (args.size() > 3) ? std::stoull(args.at(3)) : 1;
+  const std::uint64_t LastLine =
+      (args.size() > 4) ? std::stoull(args.at(4))
+                        : std::numeric_limits<std::uint64_t>::max();
+
+  const auto Model = ModelID::getModel(ModelName);
+  if (Model == ModelID::ModelIDs::NotSet)
+  {
+    std::cerr << "Model " << ModelName << " is not known to BSMPT" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::shared_ptr<BSMPT::Class_Potential_Origin> modelPointer =
+      ModelID::FChoose(Model);
+
+  ReferenceOptions Options;
+  Options.CalcEta      = (Model == ModelID::ModelIDs::C2HDM);
+  Options.ModelName    = ModelName;
+  Options.Model        = Model;
+  Options.Reproducible = options.count("reproducible") > 0;
+  if (options.count("mass-temperatures"))
+  {
+    Options.MassSpectrumTemperatures = std::stoul(options["mass-temperatures"]);
+    // The worker processes already use the cores
+    if (options.count("mass-threads"))
+      Options.MassSpectrumThreads = std::stoul(options["mass-threads"]);
+    else if (options.count("workers"))
+      Options.MassSpectrumThreads = 1;
+    else
+      Options.MassSpectrumThreads =
+          std::max(1u, std::thread::hardware_concurrency());
+    Options.MassSpectrumWhichMin = options.count("mass-which-min")
+                                       ? std::stoi(options["mass-which-min"])
+                                       : Minimizer::WhichMinimizerDefault;
+    const auto Settings = GetAllMinimizerSettings();
+    if (std::find(Settings.begin(),
+                  Settings.end(),
+                  Options.MassSpectrumWhichMin) == Settings.end())
+    {
+      std::cerr << "--mass-which-min has to be one of";
+      for (const auto &WhichMin : Settings)
+        std::cerr << " " << WhichMin;
+      std::cerr << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  ProgressMetrics Metrics;
+  std::unique_ptr<MetricsExporter> Exporter;
+  if (options.count("metrics-file") or options.count("metrics-socket"))
+  {
+    Metrics.RegisterModel(ModelName, GetAllMinimizerSettings());
+    Options.Metrics = &Metrics;
+    const double Interval = options.count("metrics-interval")
+                                ? std::stod(options["metrics-interval"])
+                                : 10;
+    if (not(Interval >= 1e-3))
+    {
+      std::cerr << "--metrics-interval has to be at least 0.001 seconds"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    Exporter.reset(new MetricsExporter(
+        Metrics,
+        options["metrics-file"],
+        options["metrics-socket"],
+        std::chrono::milliseconds(static_cast<long>(1000 * Interval))));
+  }
+
+  std::ifstream input(InputFileName);
+  if (not input.good())
+  {
+    std::cerr << "Can not open " << InputFileName << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<ScanPoint> Points;
+  std::string linestr;
+  std::uint64_t LineNumber{0};
+  while (std::getline(input, linestr) and LineNumber < LastLine)
+  {
+    ++LineNumber;
+    if (LineNumber < FirstLine) continue;
+    if (linestr.empty() or linestr.front() == '#') continue;
+
+    std::vector<double> Parameters;
+    std::stringstream ss(linestr);
+    double value;
+    while (ss >> value)
+      Parameters.push_back(value);
+    if (Parameters.empty()) continue;
+
+    ScanPoint point;
+    point.PointID    = LineNumber;
+    point.Parameters = Parameters;
+    Points.push_back(point);
+  }
+
+  ReferenceArchiveWriter archive(OutputFileName);
+  std::unique_ptr<RunReportWriter> report;
+  if (options.count("report"))
+    report.reset(new RunReportWriter(options["report"], ModelName));
+  auto OnPoint = [&](const PointRecord &point)
+  {
+    archive.Add(point);
+    if (report) report->Add(point);
+  };
+
+  std::size_t FailedPoints{0};
+  if (options.count("workers"))
+  {
+    ProcessPoolOptions PoolOptions;
+    PoolOptions.NumberOfWorkers = std::stoul(options["workers"]);
+    if (options.count("max-retries"))
+      PoolOptions.MaxRetries = std::stoul(options["max-retries"]);
+    if (options.count("task-timeout"))
+      PoolOptions.TaskTimeout =
+          std::chrono::seconds(std::stol(options["task-timeout"]));
+    FailedPoints = CalcReferencePointsInProcessPool(
+        modelPointer, Points, Options, PoolOptions, OnPoint);
+  }
+  else
+  {
+    // Everything is queued up front, so the queued gauge shows the remaining
+    // work of the whole scan as in the worker mode
+    if (Options.Metrics)
+    {
+      for (std::size_t p{0}; p < Points.size(); ++p)
+      {
+        for (const auto &WhichMin : GetAllMinimizerSettings())
+          Options.Metrics->TaskQueued(
+              Options.Metrics->Tasks(Options.ModelName, WhichMin));
+      }
+    }
+    for (const auto &point : Points)
+    {
+      OnPoint(CalcReferencePoint(
+          modelPointer, point.PointID, point.Parameters, Options));
+    }
+  }
+
+  archive.Close();
+
+  if (FailedPoints > 0)
+  {
+    std::cerr << FailedPoints << " points failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+catch (int)
+{
+  return EXIT_SUCCESS;
+}
+catch (exception &e)
+{
+  std::cerr << e.what() << std::endl;
+  return EXIT_FAILURE;
+}
@@ -12,6 +12,8 @@
 #include <BSMPT/models/ClassPotentialOrigin.h>
 #include <BSMPT/models/IncludeAllModels.h>
 
+#include "Reproducibility.h"
+
 #include <fstream>
 #include <map>
 
@@ -46,6 +48,7 @@ try
       << "// SPDX-License-Identifier: GPL-3.0-or-later\n"
       << "#include <BSMPT/minimizer/Minimizer.h>\n"
       << "#include <map>\n"
+      << "#include <set>\n"
       << "#include <vector>\n"
       << "class Compare_C2HDM\n "
       << "{\n"
@@ -57,6 +60,9 @@ try
       << "  Matrix3D CheckTripleCW;\n"
       << "  Matrix3D CheckTripleTree;\n"
       << "  std::map<int, BSMPT::Minimizer::EWPTReturnType> EWPTPerSetting;\n"
+      << "  // Settings depending on CMAES, whose seed BSMPT does not\n"
+         "  // expose, can differ between runs\n"
+      << "  std::set<int> NonReproducibleSettings;\n"
       << "  std::map<int,double> LWPerSetting;\n"
       << "  std::map<int,std::vector<double>> vevSymmetricPerSetting;\n"
       << "  std::map<int,std::vector<double>> etaPerSetting;\n"
@@ -108,6 +114,14 @@ try
                    << "].EWMinimum.push_back(" << 0 << ");" << std::endl;
         }
 
+        if (UseCMAES)
+        {
+          source << "  NonReproducibleSettings.insert(" << WhichMin << ");"
+                 << std::endl;
+        }
+
+        // The unit tests recompute exactly this minimization per setting, so
+        // the reference does not use the SymmetricPhaseSolver of BatchScan
         std::vector<double> vevsymmetricSolution, checksym, startpoint;
         for (const auto &el : EWPT.EWMinimum)
           startpoint.push_back(0.5 * el);
@@ -133,6 +147,13 @@ try
                                           EWPT.Tc,
                                           modelPointer,
                                           Minimizer::WhichMinimizerDefault);
+          // eta is calculated with the default setting, not with WhichMin
+          if (not UseCMAES and
+              ReferenceCreator::UsesCMAES(Minimizer::WhichMinimizerDefault))
+          {
+            source << "  NonReproducibleSettings.insert(" << WhichMin << ");"
+                   << std::endl;
+          }
 
           source << "  LWPerSetting[" << WhichMin
                  << "] = " << EtaInterface.getLW() << ";" << std::endl;
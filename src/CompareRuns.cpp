@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <exception>
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+
+#include "RunComparison.h"
+#include "RunReport.h"
+
+#include <map>
+#include <string>
+
+using std::exception;
+
+/**
+ * Compares two run reports written by BatchScan --report, e.g. before and
+ * after a BSMPT upgrade. Fails if a stage got significantly slower or a value
+ * drifted beyond the tolerances.
+ *
+ * Options:
+ *  --max-slowdown=X  relative slowdown reported as regression, default 0.1
+ *  --abs-tol=X       absolute tolerance of the values, default 1e-8
+ *  --rel-tol=X       relative tolerance of the values, default 1e-6
+ *  --eta-abs-tol=X   absolute tolerance of the Eta stage, default 0
+ *  --non-reproducible-rel-tol=X
+ *                    relative tolerance of entries depending on CMAES, by
+ *                    default their values are not compared
+ *  --min-seconds=X   shorter timings are not compared, default 1e-4
+ *  --min-samples=N   minimal number of timings per stage, default 3
+ */
+int main(int argc, char *argv[])
+try
+{
+  std::vector<std::string> args;
+  std::map<std::string, std::string> options;
+  for (int i{1}; i < argc; ++i)
+  {
+    const std::string arg{argv[i]};
+    if (arg.compare(0, 2, "--") == 0)
+    {
+      const auto pos = arg.find('=');
+      options[arg.substr(2, pos - 2)] =
+          (pos == std::string::npos) ? "" : arg.substr(pos + 1);
+    }
+    else
+    {
+      args.push_back(arg);
+    }
+  }
+
+  if (args.size() != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " BaselineReport CandidateReport"
+              << " [--max-slowdown=X] [--abs-tol=X] [--rel-tol=X]"
+              << " [--eta-abs-tol=X]"
+              << " [--min-seconds=X] [--min-samples=N]"
+              << " [--non-reproducible-rel-tol=X]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  using namespace ReferenceCreator;
+
+  ComparisonOptions Options;
+  if (options.count("max-slowdown"))
+    Options.MaxSlowdown = std::stod(options["max-slowdown"]);
+  if (options.count("abs-tol"))
+    Options.AbsoluteTolerance = std::stod(options["abs-tol"]);
+  if (options.count("rel-tol"))
+    Options.RelativeTolerance = std::stod(options["rel-tol"]);
+  if (options.count("eta-abs-tol"))
+    Options.EtaAbsoluteTolerance = std::stod(options["eta-abs-tol"]);
+  if (options.count("non-reproducible-rel-tol"))
+  {
+    Options.NonReproducibleRelativeTolerance =
+        std::stod(options["non-reproducible-rel-tol"]);
+  }
+  if (options.count("min-seconds"))
+    Options.MinSeconds = std::stod(options["min-seconds"]);
+  if (options.count("min-samples"))
+    Options.MinSamples = std::stoul(options["min-samples"]);
+
+  const auto Baseline  = ReadRunReport(args.at(0));
+  const auto Candidate = ReadRunReport(args.at(1));
+
+  auto Version = [](const RunReport &report)
+  {
+    auto it = report.Header.find("bsmpt_version");
+    return (it == report.Header.end()) ? std::string{"unknown"} : it->second;
+  };
+  std::cout << "Baseline:  " << args.at(0) << " (BSMPT " << Version(Baseline)
+            << ")\n"
+            << "Candidate: " << args.at(1) << " (BSMPT " << Version(Candidate)
+            << ")\n\n";
+
+  const auto Result = CompareRunReports(Baseline, Candidate, Options);
+  PrintComparison(std::cout, Result);
+
+  return Result.Passed() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (exception &e)
+{
+  std::cerr << e.what() << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "MassSpectrum.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+void CalcMassSpectrumRows(
+    MassSpectrumTable &table,
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const std::vector<std::vector<double>> &vevs,
+    std::size_t FirstTemperature,
+    std::size_t Stride)
+{
+  for (std::size_t i{FirstTemperature}; i < table.Temperatures.size();
+       i += Stride)
+  {
+    const auto Temp = table.Temperatures[i];
+    for (std::size_t phase{0}; phase < MassSpectrumTable::NumberOfPhases;
+         ++phase)
+    {
+      const auto &vev   = vevs.at(phase);
+      const auto Higgs  = modelPointer->HiggsMassesSquared(vev, Temp);
+      const auto Gauge  = modelPointer->GaugeMassesSquared(vev, Temp);
+      const auto Quark  = modelPointer->QuarkMassesSquared(vev);
+      const auto Lepton = modelPointer->LeptonMassesSquared(vev);
+      if (Higgs.size() != table.NHiggs or Gauge.size() != table.NGauge or
+          Quark.size() != table.NQuark or Lepton.size() != table.NLepton)
+      {
+        throw std::runtime_error(
+            "CalcMassSpectrumTable: number of masses changed with the "
+            "temperature");
+      }
+      auto row = table.Row(static_cast<MassSpectrumTable::Phase>(phase), i);
+      row      = std::copy(Higgs.begin(), Higgs.end(), row);
+      row      = std::copy(Gauge.begin(), Gauge.end(), row);
+      row      = std::copy(Quark.begin(), Quark.end(), row);
+      std::copy(Lepton.begin(), Lepton.end(), row);
+    }
+  }
+}
+} // namespace
+
+ModelFactory MakeModelFactory(BSMPT::ModelID::ModelIDs Model,
+                              const std::vector<double> &Parameters)
+{
+  return [Model, Parameters]()
+  {
+    std::shared_ptr<BSMPT::Class_Potential_Origin> modelPointer =
+        BSMPT::ModelID::FChoose(Model);
+    modelPointer->initModel(Parameters);
+    return modelPointer;
+  };
+}
+
+MassSpectrumTable
+MassSpectrumLayout(const std::shared_ptr<BSMPT::Class_Potential_Origin> &model)
+{
+  const std::vector<double> vev(model->get_NHiggs(), 0);
+  MassSpectrumTable table;
+  table.NHiggs  = model->HiggsMassesSquared(vev, 0).size();
+  table.NGauge  = model->GaugeMassesSquared(vev, 0).size();
+  table.NQuark  = model->QuarkMassesSquared(vev).size();
+  table.NLepton = model->LeptonMassesSquared(vev).size();
+  return table;
+}
+
+MassSpectrumTable CalcMassSpectrumTable(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const ModelFactory &CreateModel,
+    const std::vector<double> &EWMinimum,
+    const std::vector<double> &SymmetricMinimum,
+    double Tc,
+    std::size_t NumberOfTemperatures,
+    std::size_t NumberOfThreads)
+{
+  if (NumberOfTemperatures == 0) return MassSpectrumTable{};
+
+  auto table = MassSpectrumLayout(modelPointer);
+  const std::vector<std::vector<double>> vevs{
+      modelPointer->MinimizeOrderVEV(EWMinimum),
+      modelPointer->MinimizeOrderVEV(SymmetricMinimum)};
+
+  table.Temperatures.resize(NumberOfTemperatures, 0);
+  for (std::size_t i{1}; i < NumberOfTemperatures; ++i)
+    table.Temperatures[i] = Tc * i / (NumberOfTemperatures - 1);
+
+  table.Data.resize(MassSpectrumTable::NumberOfPhases * NumberOfTemperatures *
+                    table.RowSize());
+
+  NumberOfThreads = std::max<std::size_t>(
+      1,
+      std::min(NumberOfThreads,
+               NumberOfTemperatures / MinTemperaturesPerThread));
+  std::vector<std::exception_ptr> errors(NumberOfThreads);
+  std::vector<std::thread> threads;
+  for (std::size_t n{1}; n < NumberOfThreads; ++n)
+  {
+    threads.emplace_back(
+        [&, n]()
+        {
+          try
+          {
+            CalcMassSpectrumRows(
+                table, CreateModel(), vevs, n, NumberOfThreads);
+          }
+          catch (...)
+          {
+            errors[n] = std::current_exception();
+          }
+        });
+  }
+  try
+  {
+    CalcMassSpectrumRows(table, modelPointer, vevs, 0, NumberOfThreads);
+  }
+  catch (...)
+  {
+    errors[0] = std::current_exception();
+  }
+  for (auto &thread : threads)
+    thread.join();
+  for (const auto &error : errors)
+  {
+    if (error) std::rethrow_exception(error);
+  }
+
+  return table;
+}
+
+} // namespace ReferenceCreator
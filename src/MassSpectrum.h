@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "ReferenceArchive.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <BSMPT/models/ClassPotentialOrigin.h>
+#include <BSMPT/models/IncludeAllModels.h>
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Fewer temperatures do not pay for the initialisation of another model
+ */
+const std::size_t MinTemperaturesPerThread = 8;
+
+/**
+ * @brief Creates an initialised model instance for an additional thread
+ */
+using ModelFactory =
+    std::function<std::shared_ptr<BSMPT::Class_Potential_Origin>()>;
+
+ModelFactory MakeModelFactory(BSMPT::ModelID::ModelIDs Model,
+                              const std::vector<double> &Parameters);
+
+/**
+ * @brief Empty table with the number of Higgs, gauge, quark and lepton masses
+ * of the initialised model
+ */
+MassSpectrumTable
+MassSpectrumLayout(const std::shared_ptr<BSMPT::Class_Potential_Origin> &model);
+
+/**
+ * @brief Evaluates the Higgs, gauge, quark and lepton masses squared in the
+ * broken and the symmetric minimum on NumberOfTemperatures equidistant
+ * temperatures from 0 to Tc.
+ *
+ * The temperatures are distributed over at most NumberOfThreads threads, with
+ * at least MinTemperaturesPerThread temperatures each. The calling thread
+ * uses modelPointer, every additional one its own model from CreateModel, and
+ * every thread writes directly into its rows of the table.
+ *
+ * @param modelPointer model initialised with the parameters of the point
+ * @param EWMinimum broken minimum in the order of the minimizer
+ * @param SymmetricMinimum symmetric minimum in the order of the minimizer
+ */
+MassSpectrumTable CalcMassSpectrumTable(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const ModelFactory &CreateModel,
+    const std::vector<double> &EWMinimum,
+    const std::vector<double> &SymmetricMinimum,
+    double Tc,
+    std::size_t NumberOfTemperatures,
+    std::size_t NumberOfThreads);
+
+} // namespace ReferenceCreator
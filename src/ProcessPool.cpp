@@ -0,0 +1,310 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProcessPool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+enum SlotStatus : std::int32_t
+{
+  SlotPending,
+  SlotSuccess,
+  SlotFailed
+};
+
+/**
+ * Fixed layout at the beginning of every result slot, followed by
+ * SlotCapacity doubles
+ */
+struct SlotHeader
+{
+  std::uint64_t TaskID;
+  std::int32_t Status;
+  std::uint32_t Size;
+  char Error[256];
+};
+
+/// Returns false on end of file or error
+bool ReadAll(int fd, void *data, std::size_t size)
+{
+  auto bytes = static_cast<char *>(data);
+  while (size > 0)
+  {
+    const auto n = read(fd, bytes, size);
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void *data, std::size_t size)
+{
+  auto bytes = static_cast<const char *>(data);
+  while (size > 0)
+  {
+    const auto n = write(fd, bytes, size);
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+} // namespace
+
+ProcessPool::ProcessPool(std::size_t NumberOfWorkers,
+                         std::size_t SlotCapacity,
+                         WorkerFunction Worker,
+                         std::size_t MaxRetries,
+                         std::chrono::seconds TaskTimeout)
+    : mWorker(std::move(Worker))
+    , mSlotCapacity(SlotCapacity)
+    , mSlotSize(sizeof(SlotHeader) + SlotCapacity * sizeof(double))
+    , mMaxRetries(MaxRetries)
+    , mTaskTimeout(TaskTimeout)
+    , mWorkers(std::max<std::size_t>(NumberOfWorkers, 1))
+{
+  // Writing to the pipe of a crashed worker has to fail instead of
+  // terminating the parent
+  std::signal(SIGPIPE, SIG_IGN);
+
+  mSharedMemorySize = mSlotSize * mWorkers.size();
+  mSharedMemory     = mmap(nullptr,
+                       mSharedMemorySize,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS,
+                       -1,
+                       0);
+  if (mSharedMemory == MAP_FAILED)
+  {
+    mSharedMemory = nullptr;
+    throw std::runtime_error("ProcessPool: can not allocate shared memory");
+  }
+
+  for (std::size_t i{0}; i < mWorkers.size(); ++i)
+    Spawn(i);
+}
+
+ProcessPool::~ProcessPool()
+{
+  // A worker still busy with a task, e.g. if Run was left by an exception,
+  // would otherwise block the destructor until its task is finished
+  for (std::size_t i{0}; i < mWorkers.size(); ++i)
+    Stop(i, mWorkers[i].Current >= 0);
+  if (mSharedMemory) munmap(mSharedMemory, mSharedMemorySize);
+}
+
+unsigned char *ProcessPool::Slot(std::size_t index) const
+{
+  return static_cast<unsigned char *>(mSharedMemory) + index * mSlotSize;
+}
+
+void ProcessPool::Spawn(std::size_t index)
+{
+  int TaskPipe[2], DonePipe[2];
+  if (pipe(TaskPipe) != 0)
+    throw std::runtime_error("ProcessPool: can not create pipe");
+  if (pipe(DonePipe) != 0)
+  {
+    close(TaskPipe[0]);
+    close(TaskPipe[1]);
+    throw std::runtime_error("ProcessPool: can not create pipe");
+  }
+
+  // Buffered output would otherwise be written by parent and child
+  std::cout.flush();
+  std::cerr.flush();
+
+  const pid_t pid = fork();
+  if (pid < 0)
+  {
+    for (int fd : {TaskPipe[0], TaskPipe[1], DonePipe[0], DonePipe[1]})
+      close(fd);
+    throw std::runtime_error("ProcessPool: fork failed");
+  }
+  if (pid == 0)
+  {
+    close(TaskPipe[1]);
+    close(DonePipe[0]);
+    for (const auto &worker : mWorkers)
+    {
+      if (worker.TaskFD >= 0) close(worker.TaskFD);
+      if (worker.DoneFD >= 0) close(worker.DoneFD);
+    }
+    WorkerLoop(index, TaskPipe[0], DonePipe[1]);
+  }
+
+  close(TaskPipe[0]);
+  close(DonePipe[1]);
+  auto &worker   = mWorkers.at(index);
+  worker.PID     = pid;
+  worker.TaskFD  = TaskPipe[1];
+  worker.DoneFD  = DonePipe[0];
+  worker.Current = -1;
+}
+
+void ProcessPool::Stop(std::size_t index, bool Kill)
+{
+  auto &worker = mWorkers.at(index);
+  if (worker.TaskFD >= 0) close(worker.TaskFD);
+  if (Kill and worker.PID > 0) kill(worker.PID, SIGKILL);
+  if (worker.PID > 0)
+  {
+    int status;
+    while (waitpid(worker.PID, &status, 0) < 0 and errno == EINTR)
+      continue;
+  }
+  if (worker.DoneFD >= 0) close(worker.DoneFD);
+  worker = Worker{};
+}
+
+void ProcessPool::WorkerLoop(std::size_t index, int TaskFD, int DoneFD)
+{
+  auto header = reinterpret_cast<SlotHeader *>(Slot(index));
+  auto values = reinterpret_cast<double *>(Slot(index) + sizeof(SlotHeader));
+  PoolTask task;
+  while (ReadAll(TaskFD, &task, sizeof(task)))
+  {
+    header->TaskID   = task.TaskID;
+    header->Status   = SlotPending;
+    header->Size     = 0;
+    header->Error[0] = '\0';
+    try
+    {
+      const auto result = mWorker(task);
+      if (result.size() > mSlotCapacity)
+      {
+        throw std::runtime_error("ProcessPool: result of task " +
+                                 std::to_string(task.TaskID) +
+                                 " exceeds the slot capacity");
+      }
+      std::copy(result.begin(), result.end(), values);
+      header->Size   = static_cast<std::uint32_t>(result.size());
+      header->Status = SlotSuccess;
+    }
+    catch (std::exception &e)
+    {
+      std::strncpy(header->Error, e.what(), sizeof(header->Error) - 1);
+      header->Error[sizeof(header->Error) - 1] = '\0';
+      header->Status                           = SlotFailed;
+    }
+    if (not WriteAll(DoneFD, &task.TaskID, sizeof(task.TaskID))) break;
+  }
+  // Leave without running destructors or flushing buffers of the parent
+  _exit(EXIT_SUCCESS);
+}
+
+void ProcessPool::Run(const std::vector<PoolTask> &Tasks,
+                      const StartCallback &OnStart,
+                      const ResultCallback &OnResult)
+{
+  std::deque<std::size_t> pending;
+  for (std::size_t i{0}; i < Tasks.size(); ++i)
+    pending.push_back(i);
+  std::vector<std::size_t> attempts(Tasks.size(), 0);
+  std::size_t remaining = Tasks.size();
+
+  auto Crashed = [&](std::size_t index, const std::string &reason)
+  {
+    const auto current = static_cast<std::size_t>(mWorkers.at(index).Current);
+    Stop(index, true);
+    if (++attempts.at(current) <= mMaxRetries)
+    {
+      std::cerr << "Worker " << index << " " << reason << ", retrying task "
+                << Tasks.at(current).TaskID << std::endl;
+      pending.push_front(current);
+    }
+    else
+    {
+      PoolResult result;
+      result.Error = "worker " + reason;
+      OnResult(Tasks.at(current), result);
+      --remaining;
+    }
+    Spawn(index);
+  };
+
+  while (remaining > 0)
+  {
+    for (std::size_t i{0}; i < mWorkers.size() and not pending.empty(); ++i)
+    {
+      auto &worker = mWorkers[i];
+      if (worker.Current >= 0) continue;
+      const auto next = pending.front();
+      pending.pop_front();
+      if (attempts.at(next) == 0 and OnStart) OnStart(Tasks.at(next));
+      worker.Current = static_cast<std::int64_t>(next);
+      worker.Started = std::chrono::steady_clock::now();
+      if (not WriteAll(worker.TaskFD, &Tasks.at(next), sizeof(PoolTask)))
+        Crashed(i, "is not reachable");
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<std::size_t> busy;
+    for (std::size_t i{0}; i < mWorkers.size(); ++i)
+    {
+      if (mWorkers[i].Current < 0) continue;
+      fds.push_back(pollfd{mWorkers[i].DoneFD, POLLIN, 0});
+      busy.push_back(i);
+    }
+    if (fds.empty()) continue;
+    if (poll(fds.data(), fds.size(), 200) < 0 and errno != EINTR)
+      throw std::runtime_error("ProcessPool: poll failed");
+
+    for (std::size_t n{0}; n < fds.size(); ++n)
+    {
+      const auto i = busy[n];
+      auto &worker = mWorkers[i];
+      if (fds[n].revents != 0)
+      {
+        std::uint64_t TaskID;
+        const auto &task = Tasks.at(static_cast<std::size_t>(worker.Current));
+        if (not ReadAll(worker.DoneFD, &TaskID, sizeof(TaskID)) or
+            TaskID != task.TaskID)
+        {
+          Crashed(i, "died");
+          continue;
+        }
+
+        auto header = reinterpret_cast<const SlotHeader *>(Slot(i));
+        auto values =
+            reinterpret_cast<const double *>(Slot(i) + sizeof(SlotHeader));
+        PoolResult result;
+        result.Success = (header->Status == SlotSuccess);
+        if (result.Success)
+          result.Values.assign(values, values + header->Size);
+        else
+          result.Error = header->Error;
+        worker.Current = -1;
+        --remaining;
+        OnResult(task, result);
+      }
+      else if (mTaskTimeout.count() > 0 and
+               std::chrono::steady_clock::now() - worker.Started > mTaskTimeout)
+      {
+        Crashed(i, "exceeded the timeout");
+      }
+    }
+  }
+}
+
+} // namespace ReferenceCreator
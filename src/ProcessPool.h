@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @file
+ * Executes tasks in a bounded pool of forked worker processes, so that a
+ * crash or global state of the backend can not affect other tasks. Tasks are
+ * sent to the workers over pipes, the results are written into fixed size
+ * slots of a shared memory region and collected by the parent process.
+ */
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Fixed layout task description, sent as is over the pipe
+ */
+struct PoolTask
+{
+  std::uint64_t TaskID{0};
+  std::uint64_t PointIndex{0};
+  std::int32_t WhichMin{0};
+  std::int32_t Stage{0};
+};
+
+struct PoolResult
+{
+  bool Success{false};
+  std::vector<double> Values;
+  std::string Error;
+};
+
+class ProcessPool
+{
+public:
+  /**
+   * @brief Calculates the result of a task inside a worker process. Throwing
+   * marks the task as failed, a crash of the worker leads to a retry.
+   */
+  using WorkerFunction = std::function<std::vector<double>(const PoolTask &)>;
+  using StartCallback  = std::function<void(const PoolTask &)>;
+  using ResultCallback =
+      std::function<void(const PoolTask &, const PoolResult &)>;
+
+  /**
+   * @param NumberOfWorkers number of worker processes
+   * @param SlotCapacity maximal number of doubles a task can return
+   * @param Worker function executed in the worker processes
+   * @param MaxRetries number of times a task is retried after its worker died
+   * @param TaskTimeout workers exceeding it are killed and treated as crashed,
+   * zero disables the timeout
+   */
+  ProcessPool(std::size_t NumberOfWorkers,
+              std::size_t SlotCapacity,
+              WorkerFunction Worker,
+              std::size_t MaxRetries           = 2,
+              std::chrono::seconds TaskTimeout = std::chrono::seconds(0));
+  ProcessPool(const ProcessPool &) = delete;
+  ProcessPool &operator=(const ProcessPool &) = delete;
+  ~ProcessPool();
+
+  /**
+   * @brief Executes all tasks and returns after every task succeeded or
+   * failed. The callbacks are called in the parent process.
+   */
+  void Run(const std::vector<PoolTask> &Tasks,
+           const StartCallback &OnStart,
+           const ResultCallback &OnResult);
+
+private:
+  struct Worker
+  {
+    pid_t PID{-1};
+    int TaskFD{-1};
+    int DoneFD{-1};
+    /// Index into the task list of Run, -1 if idle
+    std::int64_t Current{-1};
+    std::chrono::steady_clock::time_point Started;
+  };
+
+  void Spawn(std::size_t index);
+  void Stop(std::size_t index, bool Kill);
+  [[noreturn]] void WorkerLoop(std::size_t index, int TaskFD, int DoneFD);
+  unsigned char *Slot(std::size_t index) const;
+
+  WorkerFunction mWorker;
+  std::size_t mSlotCapacity;
+  std::size_t mSlotSize;
+  std::size_t mMaxRetries;
+  std::chrono::seconds mTaskTimeout;
+  std::vector<Worker> mWorkers;
+  void *mSharedMemory{nullptr};
+  std::size_t mSharedMemorySize{0};
+};
+
+} // namespace ReferenceCreator
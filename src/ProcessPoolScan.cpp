@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProcessPoolScan.h"
+#include "ProcessPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+struct PendingPoint
+{
+  PointRecord Record;
+  std::size_t Missing{0};
+  std::vector<std::string> Errors;
+};
+} // namespace
+
+std::size_t CalcReferencePointsInProcessPool(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const std::vector<ScanPoint> &Points,
+    const ReferenceOptions &Options,
+    const ProcessPoolOptions &PoolOptions,
+    const std::function<void(const PointRecord &)> &OnPoint)
+{
+  const auto Settings = GetAllMinimizerSettings();
+  std::map<int, std::size_t> SettingPosition;
+  for (std::size_t i{0}; i < Settings.size(); ++i)
+    SettingPosition[Settings[i]] = i;
+
+  std::vector<PoolTask> tasks;
+  std::vector<PendingPoint> pending(Points.size());
+  for (std::size_t p{0}; p < Points.size(); ++p)
+  {
+    pending[p].Record.PointID    = Points[p].PointID;
+    pending[p].Record.Parameters = Points[p].Parameters;
+    pending[p].Record.Settings.resize(Settings.size());
+    pending[p].Missing = Settings.size() + 1;
+
+    PoolTask task;
+    task.PointIndex = p;
+    for (const auto &WhichMin : Settings)
+    {
+      task.TaskID   = tasks.size();
+      task.WhichMin = WhichMin;
+      task.Stage    = static_cast<std::int32_t>(ReferenceStage::EWPT);
+      tasks.push_back(task);
+      if (Options.Metrics)
+      {
+        Options.Metrics->TaskQueued(
+            Options.Metrics->Tasks(Options.ModelName, WhichMin));
+      }
+    }
+    task.TaskID   = tasks.size();
+    task.WhichMin = 0;
+    task.Stage    = static_cast<std::int32_t>(ReferenceStage::TripleCouplings);
+    tasks.push_back(task);
+  }
+
+  // The workers only see their own copy of the counters, the parent keeps
+  // track of the task states
+  ReferenceOptions WorkerOptions = Options;
+  WorkerOptions.Metrics          = nullptr;
+  // Which settings of a point a worker calculates depends on the scheduling,
+  // so every setting solves its symmetric phase on its own
+  WorkerOptions.SymmetricSolver  = nullptr;
+  std::uint64_t InitialisedPoint = std::numeric_limits<std::uint64_t>::max();
+  auto Worker = [&](const PoolTask &task) -> std::vector<double>
+  {
+    if (task.PointIndex != InitialisedPoint)
+    {
+      modelPointer->initModel(Points.at(task.PointIndex).Parameters);
+      InitialisedPoint = task.PointIndex;
+      if (Options.MassSpectrumTemperatures > 0)
+      {
+        WorkerOptions.CreateModel = MakeModelFactory(
+            Options.Model, Points.at(task.PointIndex).Parameters);
+      }
+    }
+    if (task.Stage == static_cast<std::int32_t>(ReferenceStage::EWPT))
+    {
+      return PackSetting(
+          CalcSetting(modelPointer, task.WhichMin, WorkerOptions));
+    }
+    StageStatistics Statistics;
+    auto couplings =
+        CalcTripleCouplings(modelPointer, WorkerOptions, &Statistics);
+    return PackTripleCouplings(couplings, Statistics);
+  };
+
+  const auto NHiggs = modelPointer->get_NHiggs();
+  // The number of masses only depends on the model, so it is taken from the
+  // first point before the workers are forked
+  std::size_t MassSpectrumRow{0};
+  if (Options.MassSpectrumTemperatures > 0 and not Points.empty())
+  {
+    modelPointer->initModel(Points.front().Parameters);
+    MassSpectrumRow = MassSpectrumLayout(modelPointer).RowSize();
+  }
+  // A packed setting holds the temperatures and the table rows, the vevs and
+  // at most a few dozen other values
+  const std::size_t SlotCapacity = std::max<std::size_t>(
+      {3 + 6 * NHiggs * NHiggs * NHiggs,
+       1024 + 3 * NHiggs +
+           Options.MassSpectrumTemperatures *
+               (1 + MassSpectrumTable::NumberOfPhases * MassSpectrumRow)});
+  ProcessPool pool(PoolOptions.NumberOfWorkers,
+                   SlotCapacity,
+                   Worker,
+                   PoolOptions.MaxRetries,
+                   PoolOptions.TaskTimeout);
+
+  auto IsSetting = [](const PoolTask &task)
+  { return task.Stage == static_cast<std::int32_t>(ReferenceStage::EWPT); };
+
+  // The parent only knows the stage a task starts with, so a running setting
+  // task is shown as active in the EWPT stage until it is finished
+  auto OnStart = [&](const PoolTask &task)
+  {
+    if (Options.Metrics == nullptr) return;
+    if (IsSetting(task))
+    {
+      Options.Metrics->TaskStarted(
+          Options.Metrics->Tasks(Options.ModelName, task.WhichMin));
+    }
+    Options.Metrics
+        ->Stage(Options.ModelName, static_cast<ReferenceStage>(task.Stage))
+        .Active.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  auto ReportStage = [&](ReferenceStage stage, const StageStatistics &stats)
+  {
+    if (Options.Metrics == nullptr or stats.Seconds <= 0) return;
+    Options.Metrics->StageFinished(
+        Options.Metrics->Stage(Options.ModelName, stage),
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(stats.Seconds)));
+  };
+
+  std::size_t NextPoint{0}, FailedPoints{0};
+  auto OnResult = [&](const PoolTask &task, const PoolResult &result)
+  {
+    auto &point = pending.at(task.PointIndex);
+    if (Options.Metrics)
+    {
+      Options.Metrics
+          ->Stage(Options.ModelName, static_cast<ReferenceStage>(task.Stage))
+          .Active.fetch_sub(1, std::memory_order_relaxed);
+      if (IsSetting(task))
+      {
+        Options.Metrics->TaskFinished(
+            Options.Metrics->Tasks(Options.ModelName, task.WhichMin),
+            result.Success);
+      }
+    }
+
+    if (not result.Success)
+    {
+      const auto stage = static_cast<ReferenceStage>(task.Stage);
+      point.Errors.push_back("WhichMin = " + std::to_string(task.WhichMin) +
+                             ", stage " + StageName(stage) + ": " +
+                             result.Error);
+    }
+    else if (IsSetting(task))
+    {
+      auto &setting =
+          point.Record.Settings.at(SettingPosition.at(task.WhichMin));
+      setting = UnpackSetting(result.Values);
+      for (std::size_t i{0}; i < NumberOfReferenceStages; ++i)
+        ReportStage(static_cast<ReferenceStage>(i), setting.Statistics[i]);
+    }
+    else
+    {
+      point.Record.TripleCouplings = UnpackTripleCouplings(
+          result.Values, point.Record.TripleCouplingsStatistics);
+      ReportStage(ReferenceStage::TripleCouplings,
+                  point.Record.TripleCouplingsStatistics);
+    }
+    --point.Missing;
+
+    while (NextPoint < pending.size() and pending[NextPoint].Missing == 0)
+    {
+      auto &next = pending[NextPoint];
+      if (next.Errors.empty())
+      {
+        OnPoint(next.Record);
+      }
+      else
+      {
+        ++FailedPoints;
+        std::cerr << "Point " << next.Record.PointID << " failed:\n";
+        for (const auto &el : next.Errors)
+          std::cerr << "  " << el << "\n";
+      }
+      next = PendingPoint{};
+      ++NextPoint;
+    }
+  };
+
+  pool.Run(tasks, OnStart, OnResult);
+  return FailedPoints;
+}
+
+} // namespace ReferenceCreator
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "ReferenceArchive.h"
+#include "ReferencePoint.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <BSMPT/models/ClassPotentialOrigin.h>
+
+namespace ReferenceCreator
+{
+
+struct ProcessPoolOptions
+{
+  std::size_t NumberOfWorkers{1};
+  std::size_t MaxRetries{2};
+  std::chrono::seconds TaskTimeout{0};
+};
+
+/**
+ * @brief Calculates the reference values of all points in a ProcessPool.
+ * Every (point, WhichMin) setting and the triple couplings of every point are
+ * separate tasks. OnPoint is called for the points in their input order,
+ * points with a failed task are reported and left out.
+ * @return number of points which could not be calculated
+ */
+std::size_t CalcReferencePointsInProcessPool(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const std::vector<ScanPoint> &Points,
+    const ReferenceOptions &Options,
+    const ProcessPoolOptions &PoolOptions,
+    const std::function<void(const PointRecord &)> &OnPoint);
+
+} // namespace ReferenceCreator
@@ -0,0 +1,392 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ProgressMetrics.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+std::int64_t UnixTime()
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+double Seconds(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration<double>(duration).count();
+}
+} // namespace
+
+ProgressMetrics::ProgressMetrics()
+    : mStart(std::chrono::steady_clock::now())
+    , mLastSample(mStart)
+    , mLastProgress(UnixTime())
+{
+}
+
+void ProgressMetrics::RegisterModel(const std::string &Model,
+                                    const std::vector<int> &WhichMinimizers)
+{
+  auto &counters = mModels[Model];
+  if (not counters) counters.reset(new ModelCounters);
+  for (const auto &WhichMin : WhichMinimizers)
+  {
+    auto &tasks = counters->Tasks[WhichMin];
+    if (not tasks) tasks.reset(new TaskCounters);
+  }
+}
+
+ProgressMetrics::ModelCounters &ProgressMetrics::Model(const std::string &Model)
+{
+  auto it = mModels.find(Model);
+  if (it == mModels.end())
+  {
+    throw std::runtime_error("ProgressMetrics: model " + Model +
+                             " is not registered");
+  }
+  return *it->second;
+}
+
+const ProgressMetrics::ModelCounters &
+ProgressMetrics::Model(const std::string &Model) const
+{
+  return const_cast<ProgressMetrics *>(this)->Model(Model);
+}
+
+TaskCounters &ProgressMetrics::Tasks(const std::string &Model, int WhichMin)
+{
+  auto &tasks = this->Model(Model).Tasks;
+  auto it     = tasks.find(WhichMin);
+  if (it == tasks.end())
+  {
+    throw std::runtime_error("ProgressMetrics: WhichMin = " +
+                             std::to_string(WhichMin) +
+                             " is not registered for " + Model);
+  }
+  return *it->second;
+}
+
+StageCounters &ProgressMetrics::Stage(const std::string &Model,
+                                      ReferenceStage stage)
+{
+  return this->Model(Model).Stages.at(static_cast<std::size_t>(stage));
+}
+
+void ProgressMetrics::Touch()
+{
+  mLastProgress.store(UnixTime(), std::memory_order_relaxed);
+}
+
+void ProgressMetrics::TaskQueued(TaskCounters &counters)
+{
+  counters.Queued.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressMetrics::TaskStarted(TaskCounters &counters)
+{
+  counters.Queued.fetch_sub(1, std::memory_order_relaxed);
+  counters.Running.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressMetrics::TaskFinished(TaskCounters &counters, bool Success)
+{
+  counters.Running.fetch_sub(1, std::memory_order_relaxed);
+  if (Success)
+    counters.Done.fetch_add(1, std::memory_order_relaxed);
+  else
+    counters.Failed.fetch_add(1, std::memory_order_relaxed);
+  Touch();
+}
+
+void ProgressMetrics::StageFinished(StageCounters &counters,
+                                    std::chrono::steady_clock::duration elapsed)
+{
+  counters.Nanoseconds.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+      std::memory_order_relaxed);
+  counters.Completed.fetch_add(1, std::memory_order_relaxed);
+  Touch();
+}
+
+void ProgressMetrics::Sample()
+{
+  const auto now     = std::chrono::steady_clock::now();
+  const auto elapsed = Seconds(now - mLastSample);
+  if (elapsed <= 0) return;
+  mLastSample = now;
+  for (auto &model : mModels)
+  {
+    std::int64_t done{0};
+    for (const auto &tasks : model.second->Tasks)
+      done += tasks.second->Done.load(std::memory_order_relaxed);
+    model.second->Throughput.store((done - model.second->LastDone) / elapsed,
+                                   std::memory_order_relaxed);
+    model.second->LastDone = done;
+  }
+}
+
+std::string ProgressMetrics::Render() const
+{
+  std::stringstream out;
+  out << "# HELP bsmpt_reference_tasks Tasks per model, WhichMin and state\n"
+      << "# TYPE bsmpt_reference_tasks gauge\n";
+  for (const auto &model : mModels)
+  {
+    for (const auto &tasks : model.second->Tasks)
+    {
+      const auto &counters = *tasks.second;
+      const std::string labels =
+          "model=\"" + model.first +
+          "\",which_min=\"" + std::to_string(tasks.first) + "\",state=";
+      out << "bsmpt_reference_tasks{" << labels << "\"queued\"} "
+          << counters.Queued.load(std::memory_order_relaxed) << "\n"
+          << "bsmpt_reference_tasks{" << labels << "\"running\"} "
+          << counters.Running.load(std::memory_order_relaxed) << "\n"
+          << "bsmpt_reference_tasks{" << labels << "\"done\"} "
+          << counters.Done.load(std::memory_order_relaxed) << "\n"
+          << "bsmpt_reference_tasks{" << labels << "\"failed\"} "
+          << counters.Failed.load(std::memory_order_relaxed) << "\n";
+    }
+  }
+
+  out << "# HELP bsmpt_reference_stage_active Calculations currently in the "
+         "stage\n"
+      << "# TYPE bsmpt_reference_stage_active gauge\n";
+  for (const auto &model : mModels)
+  {
+    for (std::size_t i{0}; i < NumberOfReferenceStages; ++i)
+    {
+      out << "bsmpt_reference_stage_active{model=\"" << model.first
+          << "\",stage=\"" << StageName(static_cast<ReferenceStage>(i))
+          << "\"} "
+          << model.second->Stages[i].Active.load(std::memory_order_relaxed)
+          << "\n";
+    }
+  }
+
+  out << "# HELP bsmpt_reference_stage_seconds_total Time spent in the "
+         "stage\n"
+      << "# TYPE bsmpt_reference_stage_seconds_total counter\n";
+  for (const auto &model : mModels)
+  {
+    for (std::size_t i{0}; i < NumberOfReferenceStages; ++i)
+    {
+      out << "bsmpt_reference_stage_seconds_total{model=\"" << model.first
+          << "\",stage=\"" << StageName(static_cast<ReferenceStage>(i))
+          << "\"} "
+          << 1e-9 * model.second->Stages[i].Nanoseconds.load(
+                        std::memory_order_relaxed)
+          << "\n";
+    }
+  }
+
+  out << "# HELP bsmpt_reference_stage_completed_total Finished calculations "
+         "of the stage\n"
+      << "# TYPE bsmpt_reference_stage_completed_total counter\n";
+  for (const auto &model : mModels)
+  {
+    for (std::size_t i{0}; i < NumberOfReferenceStages; ++i)
+    {
+      out << "bsmpt_reference_stage_completed_total{model=\"" << model.first
+          << "\",stage=\"" << StageName(static_cast<ReferenceStage>(i))
+          << "\"} "
+          << model.second->Stages[i].Completed.load(std::memory_order_relaxed)
+          << "\n";
+    }
+  }
+
+  out << "# HELP bsmpt_reference_throughput_tasks_per_second Finished tasks "
+         "per second since the last sample\n"
+      << "# TYPE bsmpt_reference_throughput_tasks_per_second gauge\n";
+  for (const auto &model : mModels)
+  {
+    out << "bsmpt_reference_throughput_tasks_per_second{model=\""
+        << model.first << "\"} "
+        << model.second->Throughput.load(std::memory_order_relaxed) << "\n";
+  }
+
+  out << "# HELP bsmpt_reference_uptime_seconds Time since the job started\n"
+      << "# TYPE bsmpt_reference_uptime_seconds gauge\n"
+      << "bsmpt_reference_uptime_seconds "
+      << Seconds(std::chrono::steady_clock::now() - mStart) << "\n"
+      << "# HELP bsmpt_reference_last_progress_timestamp_seconds Unix time of "
+         "the last finished task or stage\n"
+      << "# TYPE bsmpt_reference_last_progress_timestamp_seconds gauge\n"
+      << "bsmpt_reference_last_progress_timestamp_seconds "
+      << mLastProgress.load(std::memory_order_relaxed) << "\n";
+
+  return out.str();
+}
+
+StageTimer::StageTimer(ProgressMetrics *Metrics,
+                       const std::string &Model,
+                       ReferenceStage stage,
+                       StageStatistics *Statistics)
+    : mMetrics(Metrics)
+    , mStatistics(Statistics)
+{
+  if (mMetrics)
+  {
+    mCounters = &mMetrics->Stage(Model, stage);
+    mCounters->Active.fetch_add(1, std::memory_order_relaxed);
+  }
+  mStart = std::chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer()
+{
+  const auto elapsed = std::chrono::steady_clock::now() - mStart;
+  if (mStatistics) mStatistics->Seconds += Seconds(elapsed);
+  if (mCounters == nullptr) return;
+  mCounters->Active.fetch_sub(1, std::memory_order_relaxed);
+  mMetrics->StageFinished(*mCounters, elapsed);
+}
+
+MetricsExporter::MetricsExporter(ProgressMetrics &Metrics,
+                                 const std::string &FileName,
+                                 const std::string &SocketPath,
+                                 std::chrono::milliseconds Interval)
+    : mMetrics(Metrics)
+    , mFileName(FileName)
+    , mSocketPath(SocketPath)
+    , mInterval(Interval)
+{
+  if (mInterval.count() <= 0)
+    throw std::runtime_error("MetricsExporter: interval has to be positive");
+  if (not mSocketPath.empty())
+  {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (mSocketPath.size() >= sizeof(address.sun_path))
+    {
+      throw std::runtime_error("MetricsExporter: socket path " + mSocketPath +
+                               " is too long");
+    }
+    std::strncpy(
+        address.sun_path, mSocketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mSocket < 0)
+      throw std::runtime_error("MetricsExporter: can not create socket");
+    // Only a stale socket of a previous run is removed, never a regular file
+    struct stat info;
+    if (lstat(mSocketPath.c_str(), &info) == 0 and S_ISSOCK(info.st_mode))
+      unlink(mSocketPath.c_str());
+    if (bind(mSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) <
+            0 or
+        listen(mSocket, 8) < 0)
+    {
+      close(mSocket);
+      throw std::runtime_error("MetricsExporter: can not listen on " +
+                               mSocketPath);
+    }
+    mSocketThread = std::thread(&MetricsExporter::SocketLoop, this);
+  }
+  mFileThread = std::thread(&MetricsExporter::FileLoop, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mCondition.notify_all();
+  if (mFileThread.joinable()) mFileThread.join();
+  if (mSocketThread.joinable()) mSocketThread.join();
+  if (mSocket >= 0)
+  {
+    close(mSocket);
+    // Removes the socket bound above, unless the path was replaced meanwhile
+    struct stat info;
+    if (lstat(mSocketPath.c_str(), &info) == 0 and S_ISSOCK(info.st_mode))
+      unlink(mSocketPath.c_str());
+  }
+  try
+  {
+    mMetrics.Sample();
+    WriteFile();
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void MetricsExporter::WriteFile() const
+{
+  if (mFileName.empty()) return;
+  // rename is atomic, a reader never sees a partially written file
+  const std::string TmpFileName = mFileName + ".tmp";
+  {
+    std::ofstream out(TmpFileName, std::ios::trunc);
+    out << mMetrics.Render();
+    if (not out.good())
+    {
+      throw std::runtime_error("MetricsExporter: can not write " +
+                               TmpFileName);
+    }
+  }
+  if (std::rename(TmpFileName.c_str(), mFileName.c_str()) != 0)
+    throw std::runtime_error("MetricsExporter: can not replace " + mFileName);
+}
+
+void MetricsExporter::FileLoop()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (not mStop)
+  {
+    mMetrics.Sample();
+    try
+    {
+      WriteFile();
+    }
+    catch (std::exception &e)
+    {
+      std::cerr << e.what() << std::endl;
+    }
+    mCondition.wait_for(lock, mInterval, [this] { return mStop.load(); });
+  }
+}
+
+void MetricsExporter::SocketLoop()
+{
+  while (not mStop)
+  {
+    pollfd fd{mSocket, POLLIN, 0};
+    if (poll(&fd, 1, 200) <= 0) continue;
+    const int client = accept(mSocket, nullptr, nullptr);
+    if (client < 0) continue;
+    const auto text = mMetrics.Render();
+    std::size_t written{0};
+    while (written < text.size())
+    {
+      const auto n = send(
+          client, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+      if (n <= 0) break;
+      written += static_cast<std::size_t>(n);
+    }
+    close(client);
+  }
+}
+
+} // namespace ReferenceCreator
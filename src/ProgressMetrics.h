@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "ReferenceStage.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file
+ * Progress counters of long running generator jobs and their export in the
+ * Prometheus text exposition format. The counters are plain atomics, so
+ * updating them from the calculation does not take a lock.
+ */
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Task states of one (model, WhichMin) combination
+ */
+struct TaskCounters
+{
+  std::atomic<std::int64_t> Queued{0};
+  std::atomic<std::int64_t> Running{0};
+  std::atomic<std::int64_t> Done{0};
+  std::atomic<std::int64_t> Failed{0};
+};
+
+struct StageCounters
+{
+  /// Number of calculations currently inside the stage
+  std::atomic<std::int64_t> Active{0};
+  std::atomic<std::uint64_t> Completed{0};
+  std::atomic<std::uint64_t> Nanoseconds{0};
+};
+
+class ProgressMetrics
+{
+public:
+  ProgressMetrics();
+
+  /**
+   * @brief Creates the counters of a model. Has to be called for every model
+   * before the counters are used, the lookup afterwards is read only.
+   */
+  void RegisterModel(const std::string &Model,
+                     const std::vector<int> &WhichMinimizers);
+
+  TaskCounters &Tasks(const std::string &Model, int WhichMin);
+  StageCounters &Stage(const std::string &Model, ReferenceStage stage);
+
+  void TaskQueued(TaskCounters &counters);
+  void TaskStarted(TaskCounters &counters);
+  void TaskFinished(TaskCounters &counters, bool Success);
+  void StageFinished(StageCounters &counters,
+                     std::chrono::steady_clock::duration elapsed);
+
+  /**
+   * @brief Updates the throughput over the time since the last call. Called
+   * periodically by the MetricsExporter.
+   */
+  void Sample();
+
+  /**
+   * @brief All metrics in the Prometheus text exposition format
+   */
+  std::string Render() const;
+
+private:
+  struct ModelCounters
+  {
+    std::map<int, std::unique_ptr<TaskCounters>> Tasks;
+    std::array<StageCounters, NumberOfReferenceStages> Stages;
+    std::atomic<double> Throughput{0};
+    std::int64_t LastDone{0};
+  };
+
+  ModelCounters &Model(const std::string &Model);
+  const ModelCounters &Model(const std::string &Model) const;
+  void Touch();
+
+  std::map<std::string, std::unique_ptr<ModelCounters>> mModels;
+  std::chrono::steady_clock::time_point mStart;
+  std::chrono::steady_clock::time_point mLastSample;
+  std::atomic<std::int64_t> mLastProgress;
+};
+
+/**
+ * @brief Measures the time spent in a stage for the metrics and, if given,
+ * adds it to Statistics. Does nothing without either of them.
+ */
+class StageTimer
+{
+public:
+  StageTimer(ProgressMetrics *Metrics,
+             const std::string &Model,
+             ReferenceStage stage,
+             StageStatistics *Statistics = nullptr);
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+  ~StageTimer();
+
+private:
+  ProgressMetrics *mMetrics;
+  StageCounters *mCounters{nullptr};
+  StageStatistics *mStatistics;
+  std::chrono::steady_clock::time_point mStart;
+};
+
+/**
+ * @brief Periodically replaces FileName atomically with the rendered metrics
+ * and, if SocketPath is not empty, serves them on a Unix socket. Every
+ * connection receives the current metrics, after which it is closed. The
+ * interval has to be positive.
+ */
+class MetricsExporter
+{
+public:
+  MetricsExporter(ProgressMetrics &Metrics,
+                  const std::string &FileName,
+                  const std::string &SocketPath,
+                  std::chrono::milliseconds Interval);
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+  /**
+   * @brief Stops the threads and writes the final state
+   */
+  ~MetricsExporter();
+
+private:
+  void WriteFile() const;
+  void FileLoop();
+  void SocketLoop();
+
+  ProgressMetrics &mMetrics;
+  std::string mFileName;
+  std::string mSocketPath;
+  std::chrono::milliseconds mInterval;
+  int mSocket{-1};
+  std::atomic<bool> mStop{false};
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::thread mFileThread;
+  std::thread mSocketThread;
+};
+
+} // namespace ReferenceCreator
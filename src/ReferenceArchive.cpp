@@ -0,0 +1,642 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ReferenceArchive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+// The header magic changes with the format, older archives are rejected
+const char HeaderMagic[8]  = {'B', 'S', 'M', 'P', 'T', 'R', 'A', '4'};
+const char TrailerMagic[8] = {'B', 'S', 'M', 'P', 'T', 'R', 'I', 'X'};
+
+enum Column : std::size_t
+{
+  ColPointID,
+  ColParameters,
+  ColEWPT,
+  ColSymmetricVev,
+  ColEta,
+  ColTripleCouplings,
+  ColMassSpectrum,
+  NumberOfColumns
+};
+
+void PutVarint(std::string &out, std::uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+std::uint64_t GetVarint(const std::string &in, std::size_t &pos)
+{
+  std::uint64_t value{0};
+  for (unsigned shift{0}; shift < 64; shift += 7)
+  {
+    if (pos >= in.size())
+      throw std::runtime_error("ReferenceArchive: truncated varint");
+    const auto byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  throw std::runtime_error("ReferenceArchive: malformed varint");
+}
+
+std::uint64_t ZigZag(std::int64_t value)
+{
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t UnZigZag(std::uint64_t value)
+{
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+void PutFixed64(std::ostream &out, std::uint64_t value)
+{
+  char bytes[8];
+  for (std::size_t i{0}; i < 8; ++i)
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  out.write(bytes, 8);
+}
+
+std::uint64_t GetFixed64(std::istream &in)
+{
+  unsigned char bytes[8];
+  if (not in.read(reinterpret_cast<char *>(bytes), 8))
+    throw std::runtime_error("ReferenceArchive: unexpected end of file");
+  std::uint64_t value{0};
+  for (std::size_t i{0}; i < 8; ++i)
+    value |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+  return value;
+}
+
+void PutDouble(std::ostream &out, double value)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  PutFixed64(out, bits);
+}
+
+double GetDouble(std::istream &in)
+{
+  const auto bits = GetFixed64(in);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Escape codes for non-finite values. Finite values are limited to 9e18 steps,
+ * so these never collide with a quantized value.
+ */
+const std::int64_t QuantizedNaN = std::numeric_limits<std::int64_t>::min();
+const std::int64_t QuantizedNegInf = QuantizedNaN + 1;
+const std::int64_t QuantizedPosInf = std::numeric_limits<std::int64_t>::max();
+
+std::int64_t Quantize(double value, double step)
+{
+  if (std::isnan(value)) return QuantizedNaN;
+  if (std::isinf(value)) return (value > 0) ? QuantizedPosInf : QuantizedNegInf;
+  const double scaled = value / step;
+  if (not std::isfinite(scaled) or std::abs(scaled) > 9e18)
+  {
+    std::stringstream ss;
+    ss << "ReferenceArchive: value " << value
+       << " can not be quantized with step " << step;
+    throw std::runtime_error(ss.str());
+  }
+  return std::llround(scaled);
+}
+
+double Dequantize(std::int64_t value, double step)
+{
+  if (value == QuantizedNaN) return std::numeric_limits<double>::quiet_NaN();
+  if (value == QuantizedNegInf) return -std::numeric_limits<double>::infinity();
+  if (value == QuantizedPosInf) return std::numeric_limits<double>::infinity();
+  return value * step;
+}
+
+/**
+ * Every point contributes one row of integers to each column. The row is
+ * stored as its length followed by the differences to the same position of
+ * the previous row in the block. The differences wrap around, so the escape
+ * codes of non-finite values do not overflow.
+ */
+class ColumnEncoder
+{
+public:
+  void PutRow(const std::vector<std::int64_t> &row)
+  {
+    PutVarint(mBytes, row.size());
+    for (std::size_t i{0}; i < row.size(); ++i)
+    {
+      const std::uint64_t previous =
+          (i < mPrevious.size()) ? static_cast<std::uint64_t>(mPrevious[i]) : 0;
+      PutVarint(mBytes,
+                ZigZag(static_cast<std::int64_t>(
+                    static_cast<std::uint64_t>(row[i]) - previous)));
+    }
+    mPrevious = row;
+  }
+  const std::string &Bytes() const { return mBytes; }
+
+private:
+  std::string mBytes;
+  std::vector<std::int64_t> mPrevious;
+};
+
+class ColumnDecoder
+{
+public:
+  explicit ColumnDecoder(std::string bytes) : mBytes(std::move(bytes)) {}
+
+  const std::vector<std::int64_t> &NextRow()
+  {
+    const auto size = GetVarint(mBytes, mPos);
+    if (size > mBytes.size() - mPos)
+      throw std::runtime_error("ReferenceArchive: corrupt column row");
+    mPrevious.resize(size, 0);
+    for (auto &el : mPrevious)
+    {
+      el = static_cast<std::int64_t>(
+          static_cast<std::uint64_t>(el) +
+          static_cast<std::uint64_t>(UnZigZag(GetVarint(mBytes, mPos))));
+    }
+    return mPrevious;
+  }
+
+private:
+  std::string mBytes;
+  std::size_t mPos{0};
+  std::vector<std::int64_t> mPrevious;
+};
+
+/**
+ * Sequential access to a decoded row
+ */
+class RowReader
+{
+public:
+  explicit RowReader(const std::vector<std::int64_t> &row) : mRow(row) {}
+
+  std::int64_t Next()
+  {
+    if (mPos >= mRow.size())
+      throw std::runtime_error("ReferenceArchive: row too short");
+    return mRow[mPos++];
+  }
+  std::size_t NextSize()
+  {
+    const auto size = Next();
+    if (size < 0 or static_cast<std::size_t>(size) > mRow.size() - mPos)
+      throw std::runtime_error("ReferenceArchive: invalid length in row");
+    return static_cast<std::size_t>(size);
+  }
+  double Next(double step) { return Dequantize(Next(), step); }
+
+private:
+  const std::vector<std::int64_t> &mRow;
+  std::size_t mPos{0};
+};
+
+void AppendQuantized(std::vector<std::int64_t> &row,
+                     const std::vector<double> &values,
+                     double step)
+{
+  row.push_back(values.size());
+  for (const auto &el : values)
+    row.push_back(Quantize(el, step));
+}
+
+std::vector<double> ReadQuantized(RowReader &row, double step)
+{
+  std::vector<double> values(row.NextSize());
+  for (auto &el : values)
+    el = row.Next(step);
+  return values;
+}
+
+/**
+ * Quantizes all values of a point into one row per column. Throws before
+ * anything is written if a value can not be represented.
+ */
+std::vector<std::vector<std::int64_t>>
+EncodePoint(const PointRecord &point, const ArchiveTolerances &Tolerances)
+{
+  std::vector<std::vector<std::int64_t>> rows(NumberOfColumns);
+  rows[ColPointID] = {static_cast<std::int64_t>(point.PointID)};
+
+  std::vector<std::int64_t> row;
+  AppendQuantized(row, point.Parameters, Tolerances.Parameters);
+  rows[ColParameters] = row;
+
+  row = {static_cast<std::int64_t>(point.Settings.size())};
+  for (const auto &setting : point.Settings)
+  {
+    row.push_back(setting.WhichMin);
+    row.push_back(setting.Reproducible);
+    row.push_back(setting.StatusFlag);
+    row.push_back(Quantize(setting.Tc, Tolerances.Temperature));
+    row.push_back(Quantize(setting.vc, Tolerances.Vev));
+    AppendQuantized(row, setting.EWMinimum, Tolerances.Vev);
+  }
+  rows[ColEWPT] = row;
+
+  row = {static_cast<std::int64_t>(point.Settings.size())};
+  for (const auto &setting : point.Settings)
+  {
+    row.push_back(setting.vevSymmetricSolvedWith);
+    AppendQuantized(row, setting.vevSymmetric, Tolerances.Vev);
+  }
+  rows[ColSymmetricVev] = row;
+
+  row = {static_cast<std::int64_t>(point.Settings.size())};
+  for (const auto &setting : point.Settings)
+  {
+    row.push_back(Quantize(setting.LW, Tolerances.LW));
+    AppendQuantized(row, setting.eta, Tolerances.Eta);
+  }
+  rows[ColEta] = row;
+
+  row = {static_cast<std::int64_t>(point.TripleCouplings.size())};
+  for (const auto &el : point.TripleCouplings)
+  {
+    row.push_back(el.i);
+    row.push_back(el.j);
+    row.push_back(el.k);
+    row.push_back(Quantize(el.Tree, Tolerances.TripleCouplings));
+    row.push_back(Quantize(el.CT, Tolerances.TripleCouplings));
+    row.push_back(Quantize(el.CW, Tolerances.TripleCouplings));
+  }
+  rows[ColTripleCouplings] = row;
+
+  row = {static_cast<std::int64_t>(point.Settings.size())};
+  for (const auto &setting : point.Settings)
+  {
+    const auto &table = setting.MassSpectrum;
+    row.push_back(table.NHiggs);
+    row.push_back(table.NGauge);
+    row.push_back(table.NQuark);
+    row.push_back(table.NLepton);
+    AppendQuantized(row, table.Temperatures, Tolerances.Temperature);
+    AppendQuantized(row, table.Data, Tolerances.MassSquared);
+  }
+  rows[ColMassSpectrum] = row;
+  return rows;
+}
+
+} // namespace
+
+ReferenceArchiveWriter::ReferenceArchiveWriter(
+    const std::string &FileName,
+    const ArchiveTolerances &Tolerances,
+    std::size_t PointsPerBlock)
+    : mFile(FileName, std::ios::binary | std::ios::trunc)
+    , mTolerances(Tolerances)
+    , mPointsPerBlock(std::max<std::size_t>(PointsPerBlock, 1))
+{
+  if (not mFile.good())
+  {
+    throw std::runtime_error("ReferenceArchive: can not open " + FileName +
+                             " for writing");
+  }
+  mFile.write(HeaderMagic, sizeof(HeaderMagic));
+  PutDouble(mFile, mTolerances.Parameters);
+  PutDouble(mFile, mTolerances.Temperature);
+  PutDouble(mFile, mTolerances.Vev);
+  PutDouble(mFile, mTolerances.Eta);
+  PutDouble(mFile, mTolerances.LW);
+  PutDouble(mFile, mTolerances.TripleCouplings);
+  PutDouble(mFile, mTolerances.MassSquared);
+  PutFixed64(mFile, mPointsPerBlock);
+}
+
+ReferenceArchiveWriter::~ReferenceArchiveWriter()
+{
+  try
+  {
+    Close();
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+void ReferenceArchiveWriter::Add(const PointRecord &Point)
+{
+  if (mClosed)
+    throw std::runtime_error("ReferenceArchive: writer is already closed");
+  if (mHasPoints and Point.PointID <= mLastPointID)
+  {
+    throw std::runtime_error(
+        "ReferenceArchive: point IDs have to be strictly increasing");
+  }
+  auto rows    = EncodePoint(Point, mTolerances);
+  mHasPoints   = true;
+  mLastPointID = Point.PointID;
+  mBlock.push_back(std::move(rows));
+  if (mBlock.size() >= mPointsPerBlock) FlushBlock();
+}
+
+void ReferenceArchiveWriter::FlushBlock()
+{
+  if (mBlock.empty()) return;
+
+  std::vector<ColumnEncoder> columns(NumberOfColumns);
+  for (const auto &rows : mBlock)
+  {
+    for (std::size_t col{0}; col < NumberOfColumns; ++col)
+      columns[col].PutRow(rows[col]);
+  }
+
+  std::string block;
+  for (const auto &column : columns)
+    PutVarint(block, column.Bytes().size());
+  for (const auto &column : columns)
+    block += column.Bytes();
+
+  ArchiveBlockIndex index;
+  index.FirstPointID   = mBlock.front()[ColPointID].at(0);
+  index.LastPointID    = mBlock.back()[ColPointID].at(0);
+  index.NumberOfPoints = mBlock.size();
+  index.Offset         = static_cast<std::uint64_t>(mFile.tellp());
+  index.Size           = block.size();
+
+  mBlock.clear();
+  mFile.write(block.data(), block.size());
+  if (not mFile.good())
+    throw std::runtime_error("ReferenceArchive: failed to write block");
+  mIndex.push_back(index);
+}
+
+void ReferenceArchiveWriter::Close()
+{
+  if (mClosed) return;
+  mClosed = true;
+
+  // The index of the blocks written so far is stored even if the last block
+  // fails, otherwise all flushed points would be unreadable
+  std::exception_ptr error;
+  try
+  {
+    FlushBlock();
+  }
+  catch (std::exception &)
+  {
+    error = std::current_exception();
+  }
+
+  const auto IndexOffset = static_cast<std::uint64_t>(mFile.tellp());
+  std::string index;
+  PutVarint(index, mIndex.size());
+  for (const auto &el : mIndex)
+  {
+    PutVarint(index, el.FirstPointID);
+    PutVarint(index, el.LastPointID);
+    PutVarint(index, el.NumberOfPoints);
+    PutVarint(index, el.Offset);
+    PutVarint(index, el.Size);
+  }
+  mFile.write(index.data(), index.size());
+  PutFixed64(mFile, IndexOffset);
+  mFile.write(TrailerMagic, sizeof(TrailerMagic));
+  mFile.close();
+  if (error) std::rethrow_exception(error);
+  if (mFile.fail())
+    throw std::runtime_error("ReferenceArchive: failed to finish archive");
+}
+
+ReferenceArchiveReader::ReferenceArchiveReader(const std::string &FileName)
+    : mFile(FileName, std::ios::binary)
+{
+  if (not mFile.good())
+  {
+    throw std::runtime_error("ReferenceArchive: can not open " + FileName +
+                             " for reading");
+  }
+
+  char magic[8];
+  if (not mFile.read(magic, sizeof(magic)) or
+      not std::equal(magic, magic + sizeof(magic), HeaderMagic))
+  {
+    throw std::runtime_error("ReferenceArchive: " + FileName +
+                             " is not a reference archive");
+  }
+  mTolerances.Parameters      = GetDouble(mFile);
+  mTolerances.Temperature     = GetDouble(mFile);
+  mTolerances.Vev             = GetDouble(mFile);
+  mTolerances.Eta             = GetDouble(mFile);
+  mTolerances.LW              = GetDouble(mFile);
+  mTolerances.TripleCouplings = GetDouble(mFile);
+  mTolerances.MassSquared     = GetDouble(mFile);
+  GetFixed64(mFile); // points per block, informational only
+
+  mFile.seekg(-16, std::ios::end);
+  const auto TrailerPos  = static_cast<std::uint64_t>(mFile.tellg());
+  const auto IndexOffset = GetFixed64(mFile);
+  if (not mFile.read(magic, sizeof(magic)) or
+      not std::equal(magic, magic + sizeof(magic), TrailerMagic) or
+      IndexOffset > TrailerPos)
+  {
+    throw std::runtime_error("ReferenceArchive: " + FileName +
+                             " has no block index, was the writer closed?");
+  }
+
+  std::string index(TrailerPos - IndexOffset, '\0');
+  mFile.seekg(IndexOffset);
+  mFile.read(&index[0], index.size());
+  std::size_t pos{0};
+  mIndex.resize(GetVarint(index, pos));
+  for (auto &el : mIndex)
+  {
+    el.FirstPointID   = GetVarint(index, pos);
+    el.LastPointID    = GetVarint(index, pos);
+    el.NumberOfPoints = GetVarint(index, pos);
+    el.Offset         = GetVarint(index, pos);
+    el.Size           = GetVarint(index, pos);
+  }
+}
+
+const ArchiveBlockIndex *
+ReferenceArchiveReader::FindBlock(std::uint64_t PointID) const
+{
+  auto it = std::lower_bound(
+      mIndex.begin(),
+      mIndex.end(),
+      PointID,
+      [](const ArchiveBlockIndex &block, std::uint64_t id)
+      { return block.LastPointID < id; });
+  if (it == mIndex.end() or it->FirstPointID > PointID) return nullptr;
+  return &(*it);
+}
+
+std::vector<std::string>
+ReferenceArchiveReader::ReadColumns(const ArchiveBlockIndex &block)
+{
+  std::string bytes(block.Size, '\0');
+  mFile.clear();
+  mFile.seekg(block.Offset);
+  if (not mFile.read(&bytes[0], bytes.size()))
+    throw std::runtime_error("ReferenceArchive: failed to read block");
+
+  std::size_t pos{0};
+  std::vector<std::uint64_t> sizes(NumberOfColumns);
+  for (auto &el : sizes)
+    el = GetVarint(bytes, pos);
+  std::vector<std::string> columns;
+  for (const auto &el : sizes)
+  {
+    if (el > bytes.size() - pos)
+      throw std::runtime_error("ReferenceArchive: corrupt block");
+    columns.push_back(bytes.substr(pos, el));
+    pos += el;
+  }
+  return columns;
+}
+
+bool ReferenceArchiveReader::Contains(std::uint64_t PointID)
+{
+  const auto block = FindBlock(PointID);
+  if (block == nullptr) return false;
+
+  // The index only knows the ID range of the block, so its ID column is
+  // decoded to check for the point itself
+  ColumnDecoder ids(std::move(ReadColumns(*block).at(ColPointID)));
+  for (std::uint64_t n{0}; n < block->NumberOfPoints; ++n)
+  {
+    if (static_cast<std::uint64_t>(ids.NextRow().at(0)) == PointID)
+      return true;
+  }
+  return false;
+}
+
+std::size_t ReferenceArchiveReader::NumberOfPoints() const
+{
+  std::size_t result{0};
+  for (const auto &el : mIndex)
+    result += el.NumberOfPoints;
+  return result;
+}
+
+PointRecord ReferenceArchiveReader::Read(std::uint64_t PointID)
+{
+  const auto block = FindBlock(PointID);
+  if (block == nullptr)
+  {
+    throw std::runtime_error("ReferenceArchive: point " +
+                             std::to_string(PointID) + " is not stored");
+  }
+
+  std::vector<ColumnDecoder> columns;
+  for (auto &el : ReadColumns(*block))
+    columns.emplace_back(std::move(el));
+
+  // Rows are delta encoded, so every row up to the requested point is decoded
+  for (std::uint64_t n{0}; n < block->NumberOfPoints; ++n)
+  {
+    const auto id =
+        static_cast<std::uint64_t>(columns[ColPointID].NextRow().at(0));
+    if (id != PointID)
+    {
+      for (std::size_t col{ColParameters}; col < NumberOfColumns; ++col)
+        columns[col].NextRow();
+      continue;
+    }
+
+    PointRecord point;
+    point.PointID = id;
+
+    RowReader parameters(columns[ColParameters].NextRow());
+    point.Parameters = ReadQuantized(parameters, mTolerances.Parameters);
+
+    RowReader ewpt(columns[ColEWPT].NextRow());
+    point.Settings.resize(ewpt.NextSize());
+    for (auto &setting : point.Settings)
+    {
+      setting.WhichMin     = static_cast<int>(ewpt.Next());
+      setting.Reproducible = ewpt.Next() != 0;
+      setting.StatusFlag   = static_cast<int>(ewpt.Next());
+      setting.Tc           = ewpt.Next(mTolerances.Temperature);
+      setting.vc           = ewpt.Next(mTolerances.Vev);
+      setting.EWMinimum    = ReadQuantized(ewpt, mTolerances.Vev);
+    }
+
+    RowReader symmetric(columns[ColSymmetricVev].NextRow());
+    if (symmetric.NextSize() != point.Settings.size())
+      throw std::runtime_error("ReferenceArchive: inconsistent settings");
+    for (auto &setting : point.Settings)
+    {
+      setting.vevSymmetricSolvedWith = static_cast<int>(symmetric.Next());
+      setting.vevSymmetric =
+          ReadQuantized(symmetric, mTolerances.Vev);
+    }
+
+    RowReader eta(columns[ColEta].NextRow());
+    if (eta.NextSize() != point.Settings.size())
+      throw std::runtime_error("ReferenceArchive: inconsistent settings");
+    for (auto &setting : point.Settings)
+    {
+      setting.LW  = eta.Next(mTolerances.LW);
+      setting.eta = ReadQuantized(eta, mTolerances.Eta);
+    }
+
+    RowReader triple(columns[ColTripleCouplings].NextRow());
+    point.TripleCouplings.resize(triple.NextSize());
+    for (auto &el : point.TripleCouplings)
+    {
+      el.i    = static_cast<std::uint32_t>(triple.Next());
+      el.j    = static_cast<std::uint32_t>(triple.Next());
+      el.k    = static_cast<std::uint32_t>(triple.Next());
+      el.Tree = triple.Next(mTolerances.TripleCouplings);
+      el.CT   = triple.Next(mTolerances.TripleCouplings);
+      el.CW   = triple.Next(mTolerances.TripleCouplings);
+    }
+
+    RowReader mass(columns[ColMassSpectrum].NextRow());
+    if (mass.NextSize() != point.Settings.size())
+      throw std::runtime_error("ReferenceArchive: inconsistent settings");
+    for (auto &setting : point.Settings)
+    {
+      auto &table        = setting.MassSpectrum;
+      table.NHiggs       = static_cast<std::size_t>(mass.Next());
+      table.NGauge       = static_cast<std::size_t>(mass.Next());
+      table.NQuark       = static_cast<std::size_t>(mass.Next());
+      table.NLepton      = static_cast<std::size_t>(mass.Next());
+      table.Temperatures = ReadQuantized(mass, mTolerances.Temperature);
+      table.Data         = ReadQuantized(mass, mTolerances.MassSquared);
+      // Row() relies on the table being complete
+      if (table.RowSize() > table.Data.size() or
+          table.Data.size() != MassSpectrumTable::NumberOfPhases *
+                                   table.Temperatures.size() * table.RowSize())
+      {
+        throw std::runtime_error("ReferenceArchive: inconsistent settings");
+      }
+    }
+    return point;
+  }
+
+  throw std::runtime_error("ReferenceArchive: point " +
+                           std::to_string(PointID) + " is not stored");
+}
+
+} // namespace ReferenceCreator
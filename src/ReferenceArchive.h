@@ -0,0 +1,208 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "ReferenceStage.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @file
+ * Columnar archive for the reference values of large batch scans. Every
+ * quantity of a point is stored in its own column, quantized with a column
+ * specific tolerance and delta encoded against the previous point of the same
+ * block. A block index at the end of the file allows to decode a single point
+ * without reading the rest of the archive.
+ */
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Field and temperature dependent masses squared on a temperature
+ * grid, evaluated in the broken and the symmetric minimum
+ */
+struct MassSpectrumTable
+{
+  enum Phase : std::size_t
+  {
+    Broken,
+    Symmetric,
+    NumberOfPhases
+  };
+
+  std::vector<double> Temperatures;
+  std::size_t NHiggs{0};
+  std::size_t NGauge{0};
+  std::size_t NQuark{0};
+  std::size_t NLepton{0};
+  /// Contiguous rows [Phase][Temperature] of the Higgs, gauge, quark and
+  /// lepton masses squared
+  std::vector<double> Data;
+
+  std::size_t RowSize() const { return NHiggs + NGauge + NQuark + NLepton; }
+  const double *Row(Phase phase, std::size_t Temperature) const
+  {
+    return Data.data() +
+           (phase * Temperatures.size() + Temperature) * RowSize();
+  }
+  double *Row(Phase phase, std::size_t Temperature)
+  {
+    return Data.data() +
+           (phase * Temperatures.size() + Temperature) * RowSize();
+  }
+};
+
+/**
+ * @brief Reference values of a single minimizer setting of a point
+ */
+struct SettingRecord
+{
+  int WhichMin{0};
+  /// EWPTReturnType fields
+  int StatusFlag{0};
+  double Tc{0};
+  double vc{0};
+  std::vector<double> EWMinimum;
+  /// Solution of the symmetric phase at Tc + 1
+  std::vector<double> vevSymmetric;
+  /// WhichMin of the minimization that found vevSymmetric, differs from
+  /// WhichMin if the solution was shared with another setting
+  int vevSymmetricSolvedWith{0};
+  /// Baryogenesis results, only filled if vc/Tc > 1 and eta is calculated
+  double LW{0};
+  std::vector<double> eta;
+  /// False if the setting depends on CMAES, directly, through a shared
+  /// symmetric minimum or through the setting eta is calculated with, and
+  /// can differ between runs
+  bool Reproducible{true};
+  /// Only calculated for one setting of the point, empty otherwise
+  MassSpectrumTable MassSpectrum;
+  /// Runtime information, not stored in the archive
+  std::array<StageStatistics, NumberOfReferenceStages> Statistics;
+};
+
+/**
+ * @brief Non-vanishing entry of the triple Higgs couplings
+ */
+struct TripleCouplingEntry
+{
+  std::uint32_t i{0};
+  std::uint32_t j{0};
+  std::uint32_t k{0};
+  double Tree{0};
+  double CT{0};
+  double CW{0};
+};
+
+/**
+ * @brief All reference values of a single parameter point
+ */
+struct PointRecord
+{
+  std::uint64_t PointID{0};
+  std::vector<double> Parameters;
+  std::vector<SettingRecord> Settings;
+  std::vector<TripleCouplingEntry> TripleCouplings;
+  /// Runtime information, not stored in the archive
+  StageStatistics TripleCouplingsStatistics;
+};
+
+/**
+ * @brief Absolute quantization step of each column. Values are stored as
+ * integer multiples of these steps, so they are reproduced up to half a step.
+ */
+struct ArchiveTolerances
+{
+  double Parameters{1e-10};
+  double Temperature{1e-6};
+  double Vev{1e-6};
+  double Eta{1e-22};
+  double LW{1e-12};
+  double TripleCouplings{1e-8};
+  double MassSquared{1e-6};
+};
+
+/**
+ * @brief Position of a block inside the archive
+ */
+struct ArchiveBlockIndex
+{
+  std::uint64_t FirstPointID{0};
+  std::uint64_t LastPointID{0};
+  std::uint64_t NumberOfPoints{0};
+  std::uint64_t Offset{0};
+  std::uint64_t Size{0};
+};
+
+/**
+ * @brief Streaming writer, keeps only the current block in memory.
+ * Points have to be added with strictly increasing PointIDs. NaN and infinite
+ * values are stored as such, a point with a finite value outside of the
+ * quantization range is rejected by Add() without touching the archive.
+ */
+class ReferenceArchiveWriter
+{
+public:
+  explicit ReferenceArchiveWriter(const std::string &FileName,
+                                  const ArchiveTolerances &Tolerances = {},
+                                  std::size_t PointsPerBlock      = 64);
+  ReferenceArchiveWriter(const ReferenceArchiveWriter &) = delete;
+  ReferenceArchiveWriter &operator=(const ReferenceArchiveWriter &) = delete;
+  ~ReferenceArchiveWriter();
+
+  void Add(const PointRecord &Point);
+  /**
+   * @brief Flushes the last block and writes the block index. Called by the
+   * destructor if not done before.
+   */
+  void Close();
+
+private:
+  void FlushBlock();
+
+  std::ofstream mFile;
+  ArchiveTolerances mTolerances;
+  std::size_t mPointsPerBlock;
+  /// Quantized rows of every column for each point of the current block
+  std::vector<std::vector<std::vector<std::int64_t>>> mBlock;
+  std::vector<ArchiveBlockIndex> mIndex;
+  bool mHasPoints{false};
+  std::uint64_t mLastPointID{0};
+  bool mClosed{false};
+};
+
+/**
+ * @brief Random access reader. Only the header and the block index are read
+ * on construction, Read() decodes the single block containing the point.
+ */
+class ReferenceArchiveReader
+{
+public:
+  explicit ReferenceArchiveReader(const std::string &FileName);
+
+  /**
+   * @brief Exact check, decodes the point IDs of the block whose range
+   * contains PointID
+   */
+  bool Contains(std::uint64_t PointID);
+  PointRecord Read(std::uint64_t PointID);
+  std::size_t NumberOfPoints() const;
+  const ArchiveTolerances &GetTolerances() const { return mTolerances; }
+
+private:
+  const ArchiveBlockIndex *FindBlock(std::uint64_t PointID) const;
+  std::vector<std::string> ReadColumns(const ArchiveBlockIndex &block);
+
+  std::ifstream mFile;
+  ArchiveTolerances mTolerances;
+  std::vector<ArchiveBlockIndex> mIndex;
+};
+
+} // namespace ReferenceCreator
@@ -0,0 +1,330 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ReferencePoint.h"
+#include "Reproducibility.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <BSMPT/baryo_calculation/CalculateEtaInterface.h>
+#include <BSMPT/minimizer/Minimizer.h>
+
+namespace ReferenceCreator
+{
+
+std::vector<int> GetAllMinimizerSettings()
+{
+  std::vector<int> result;
+  for (bool UseGSL : {false, true})
+  {
+    for (bool UseCMAES : {false, true})
+    {
+      for (bool UseNLopt : {false, true})
+      {
+        if (not UseGSL and not UseCMAES and not UseNLopt) continue;
+        result.push_back(
+            BSMPT::Minimizer::CalcWhichMinimizer(UseGSL, UseCMAES, UseNLopt));
+      }
+    }
+  }
+  return result;
+}
+
+double ZeroIfSmall(double value)
+{
+  return (std::abs(value) > 1e-5) ? value : 0;
+}
+
+SettingRecord
+CalcSetting(const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+            int WhichMin,
+            const ReferenceOptions &Options)
+{
+  using namespace BSMPT;
+  SettingRecord result;
+  result.WhichMin = WhichMin;
+
+  auto &Statistics = result.Statistics;
+
+  Minimizer::EWPTReturnType EWPT;
+  {
+    auto &stats = Statistics[static_cast<std::size_t>(ReferenceStage::EWPT)];
+    StageTimer timer(
+        Options.Metrics, Options.ModelName, ReferenceStage::EWPT, &stats);
+    EWPT = Minimizer::PTFinder_gen_all(modelPointer, 0, 300, WhichMin);
+    ++stats.BackendCalls;
+  }
+  result.StatusFlag = EWPT.StatusFlag;
+  result.Tc         = EWPT.Tc;
+  result.vc         = EWPT.vc;
+  for (const auto &el : EWPT.EWMinimum)
+    result.EWMinimum.push_back(ZeroIfSmall(el));
+
+  SymmetricSolution vevsymmetricSolution;
+  {
+    auto &stats = Statistics[static_cast<std::size_t>(
+        ReferenceStage::SymmetricMinimum)];
+    StageTimer timer(Options.Metrics,
+                     Options.ModelName,
+                     ReferenceStage::SymmetricMinimum,
+                     &stats);
+    SymmetricPhaseSolver LocalSolver(modelPointer);
+    auto &solver = Options.SymmetricSolver ? *Options.SymmetricSolver
+                                           : LocalSolver;
+    const auto minimizations = solver.NumberOfMinimizations();
+    vevsymmetricSolution = solver.Solve(EWPT.Tc, EWPT.EWMinimum, WhichMin);
+    stats.BackendCalls += solver.NumberOfMinimizations() - minimizations;
+  }
+  result.vevSymmetricSolvedWith = vevsymmetricSolution.SolvedWith;
+  // Everything after the symmetric phase builds on both minima
+  result.Reproducible = not UsesCMAES(WhichMin) and
+                        not UsesCMAES(result.vevSymmetricSolvedWith);
+  for (const auto &el : vevsymmetricSolution.Minimum)
+    result.vevSymmetric.push_back(ZeroIfSmall(el));
+
+  if (Options.MassSpectrumTemperatures > 0 and
+      WhichMin == Options.MassSpectrumWhichMin and EWPT.Tc > 0)
+  {
+    auto &stats =
+        Statistics[static_cast<std::size_t>(ReferenceStage::MassSpectrum)];
+    StageTimer timer(Options.Metrics,
+                     Options.ModelName,
+                     ReferenceStage::MassSpectrum,
+                     &stats);
+    result.MassSpectrum =
+        CalcMassSpectrumTable(modelPointer,
+                              Options.CreateModel,
+                              EWPT.EWMinimum,
+                              vevsymmetricSolution.Minimum,
+                              EWPT.Tc,
+                              Options.MassSpectrumTemperatures,
+                              Options.MassSpectrumThreads);
+    ++stats.BackendCalls;
+  }
+
+  if (Options.CalcEta and EWPT.vc / EWPT.Tc > 1)
+  {
+    auto &stats = Statistics[static_cast<std::size_t>(ReferenceStage::Eta)];
+    StageTimer timer(
+        Options.Metrics, Options.ModelName, ReferenceStage::Eta, &stats);
+    auto config =
+        std::pair<std::vector<bool>, int>{std::vector<bool>(5, true), 1};
+    Baryo::CalculateEtaInterface EtaInterface(config);
+    result.eta = EtaInterface.CalcEta(Options.testVW,
+                                      EWPT.EWMinimum,
+                                      vevsymmetricSolution.Minimum,
+                                      EWPT.Tc,
+                                      modelPointer,
+                                      Minimizer::WhichMinimizerDefault);
+    result.LW  = EtaInterface.getLW();
+    ++stats.BackendCalls;
+    // eta is calculated with the default setting, not with WhichMin
+    result.Reproducible = result.Reproducible and
+                          not UsesCMAES(Minimizer::WhichMinimizerDefault);
+  }
+
+  return result;
+}
+
+std::vector<TripleCouplingEntry> CalcTripleCouplings(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const ReferenceOptions &Options,
+    StageStatistics *Statistics)
+{
+  StageTimer timer(Options.Metrics,
+                   Options.ModelName,
+                   ReferenceStage::TripleCouplings,
+                   Statistics);
+  if (Statistics) ++Statistics->BackendCalls;
+  modelPointer->Prepare_Triple();
+  modelPointer->TripleHiggsCouplings();
+  std::vector<TripleCouplingEntry> result;
+  auto NHiggs = modelPointer->get_NHiggs();
+  for (std::size_t i{0}; i < NHiggs; ++i)
+  {
+    for (std::size_t j{0}; j < NHiggs; ++j)
+    {
+      for (std::size_t k{0}; k < NHiggs; ++k)
+      {
+        TripleCouplingEntry entry;
+        entry.i    = static_cast<std::uint32_t>(i);
+        entry.j    = static_cast<std::uint32_t>(j);
+        entry.k    = static_cast<std::uint32_t>(k);
+        entry.Tree =
+            modelPointer->get_TripleHiggsCorrectionsTreePhysical(i, j, k);
+        entry.CT = modelPointer->get_TripleHiggsCorrectionsCTPhysical(i, j, k);
+        entry.CW = modelPointer->get_TripleHiggsCorrectionsCWPhysical(i, j, k);
+        if (entry.Tree != 0 or entry.CT != 0 or entry.CW != 0)
+          result.push_back(entry);
+      }
+    }
+  }
+  return result;
+}
+
+namespace
+{
+void PackVector(std::vector<double> &out, const std::vector<double> &values)
+{
+  out.push_back(values.size());
+  out.insert(out.end(), values.begin(), values.end());
+}
+
+std::vector<double> UnpackVector(const std::vector<double> &in,
+                                 std::size_t &pos)
+{
+  const auto size = static_cast<std::size_t>(in.at(pos++));
+  if (size > in.size() - pos)
+    throw std::runtime_error("UnpackVector: size exceeds the input");
+  std::vector<double> result(in.begin() + pos, in.begin() + pos + size);
+  pos += size;
+  return result;
+}
+} // namespace
+
+std::vector<double> PackSetting(const SettingRecord &Setting)
+{
+  std::vector<double> result{
+      static_cast<double>(Setting.WhichMin),
+      static_cast<double>(Setting.StatusFlag),
+      Setting.Tc,
+      Setting.vc,
+      Setting.LW,
+      static_cast<double>(Setting.vevSymmetricSolvedWith),
+      static_cast<double>(Setting.Reproducible)};
+  PackVector(result, Setting.EWMinimum);
+  PackVector(result, Setting.vevSymmetric);
+  PackVector(result, Setting.eta);
+  const auto &table = Setting.MassSpectrum;
+  result.insert(result.end(),
+                {static_cast<double>(table.NHiggs),
+                 static_cast<double>(table.NGauge),
+                 static_cast<double>(table.NQuark),
+                 static_cast<double>(table.NLepton)});
+  PackVector(result, table.Temperatures);
+  PackVector(result, table.Data);
+  for (const auto &el : Setting.Statistics)
+  {
+    result.insert(result.end(),
+                  {el.Seconds, static_cast<double>(el.BackendCalls)});
+  }
+  return result;
+}
+
+SettingRecord UnpackSetting(const std::vector<double> &Values)
+{
+  SettingRecord result;
+  std::size_t pos{0};
+  result.WhichMin               = static_cast<int>(Values.at(pos++));
+  result.StatusFlag             = static_cast<int>(Values.at(pos++));
+  result.Tc                     = Values.at(pos++);
+  result.vc                     = Values.at(pos++);
+  result.LW                     = Values.at(pos++);
+  result.vevSymmetricSolvedWith = static_cast<int>(Values.at(pos++));
+  result.Reproducible           = Values.at(pos++) != 0;
+  result.EWMinimum              = UnpackVector(Values, pos);
+  result.vevSymmetric           = UnpackVector(Values, pos);
+  result.eta                    = UnpackVector(Values, pos);
+  auto &table                   = result.MassSpectrum;
+  table.NHiggs                  = static_cast<std::size_t>(Values.at(pos++));
+  table.NGauge                  = static_cast<std::size_t>(Values.at(pos++));
+  table.NQuark                  = static_cast<std::size_t>(Values.at(pos++));
+  table.NLepton                 = static_cast<std::size_t>(Values.at(pos++));
+  table.Temperatures            = UnpackVector(Values, pos);
+  table.Data                    = UnpackVector(Values, pos);
+  for (auto &el : result.Statistics)
+  {
+    el.Seconds      = Values.at(pos++);
+    el.BackendCalls = static_cast<std::uint32_t>(Values.at(pos++));
+  }
+  return result;
+}
+
+std::vector<double>
+PackTripleCouplings(const std::vector<TripleCouplingEntry> &Couplings,
+                    const StageStatistics &Statistics)
+{
+  std::vector<double> result{Statistics.Seconds,
+                             static_cast<double>(Statistics.BackendCalls),
+                             static_cast<double>(Couplings.size())};
+  for (const auto &el : Couplings)
+  {
+    result.insert(result.end(),
+                  {static_cast<double>(el.i),
+                   static_cast<double>(el.j),
+                   static_cast<double>(el.k),
+                   el.Tree,
+                   el.CT,
+                   el.CW});
+  }
+  return result;
+}
+
+std::vector<TripleCouplingEntry>
+UnpackTripleCouplings(const std::vector<double> &Values,
+                      StageStatistics &Statistics)
+{
+  const auto size = static_cast<std::size_t>(Values.at(2));
+  if (Values.size() != 3 + 6 * size)
+    throw std::runtime_error("UnpackTripleCouplings: invalid size");
+  Statistics.Seconds      = Values[0];
+  Statistics.BackendCalls = static_cast<std::uint32_t>(Values[1]);
+  std::vector<TripleCouplingEntry> result(size);
+  for (std::size_t n{0}; n < size; ++n)
+  {
+    const auto entry = Values.begin() + 3 + 6 * n;
+    result[n].i      = static_cast<std::uint32_t>(entry[0]);
+    result[n].j      = static_cast<std::uint32_t>(entry[1]);
+    result[n].k      = static_cast<std::uint32_t>(entry[2]);
+    result[n].Tree   = entry[3];
+    result[n].CT     = entry[4];
+    result[n].CW     = entry[5];
+  }
+  return result;
+}
+
+PointRecord CalcReferencePoint(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    std::uint64_t PointID,
+    const std::vector<double> &Parameters,
+    const ReferenceOptions &Options)
+{
+  modelPointer->initModel(Parameters);
+
+  SymmetricPhaseSolver SymmetricSolver(modelPointer);
+  ReferenceOptions PointOptions = Options;
+  if (not Options.Reproducible) PointOptions.SymmetricSolver = &SymmetricSolver;
+  if (Options.MassSpectrumTemperatures > 0)
+    PointOptions.CreateModel = MakeModelFactory(Options.Model, Parameters);
+
+  PointRecord result;
+  result.PointID    = PointID;
+  result.Parameters = Parameters;
+  for (const auto &WhichMin : GetAllMinimizerSettings())
+  {
+    TaskCounters *tasks{nullptr};
+    if (Options.Metrics)
+    {
+      tasks = &Options.Metrics->Tasks(Options.ModelName, WhichMin);
+      Options.Metrics->TaskStarted(*tasks);
+    }
+    try
+    {
+      result.Settings.push_back(
+          CalcSetting(modelPointer, WhichMin, PointOptions));
+    }
+    catch (...)
+    {
+      if (tasks) Options.Metrics->TaskFinished(*tasks, false);
+      throw;
+    }
+    if (tasks) Options.Metrics->TaskFinished(*tasks, true);
+  }
+  result.TripleCouplings = CalcTripleCouplings(
+      modelPointer, Options, &result.TripleCouplingsStatistics);
+  return result;
+}
+
+} // namespace ReferenceCreator
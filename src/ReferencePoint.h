@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "MassSpectrum.h"
+#include "ProgressMetrics.h"
+#include "ReferenceArchive.h"
+#include "SymmetricPhaseSolver.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <BSMPT/models/ClassPotentialOrigin.h>
+
+/**
+ * @file
+ * Reference calculations of a single parameter point, shared by the batch
+ * scan. They reproduce what the per model generators write into the
+ * generated Compare_<Model> classes.
+ */
+
+namespace ReferenceCreator
+{
+
+struct ReferenceOptions
+{
+  /// Wall velocity used for CalcEta
+  double testVW{0.1};
+  /// Only the C2HDM provides the baryogenesis calculation
+  bool CalcEta{false};
+  /// Optional progress counters, registered for ModelName
+  ProgressMetrics *Metrics{nullptr};
+  std::string ModelName;
+  /// Shares the symmetric minimum between the settings of a point. Without
+  /// it every setting minimizes starting from 0.5 * EWMinimum.
+  SymmetricPhaseSolver *SymmetricSolver{nullptr};
+  /// Number of temperatures of the mass spectrum table, 0 disables it
+  std::size_t MassSpectrumTemperatures{0};
+  std::size_t MassSpectrumThreads{1};
+  /// Setting whose minima are used for the mass spectrum table
+  int MassSpectrumWhichMin{0};
+  BSMPT::ModelID::ModelIDs Model{BSMPT::ModelID::ModelIDs::NotSet};
+  /// Model instances of the mass spectrum threads, set for every point
+  ModelFactory CreateModel;
+  /// Calculates the settings independently of each other, so that the
+  /// results do not depend on the execution order or the number of workers
+  bool Reproducible{false};
+};
+
+/**
+ * @brief Parameter point of a scan, identified by its line in the input file
+ */
+struct ScanPoint
+{
+  std::uint64_t PointID{0};
+  std::vector<double> Parameters;
+};
+
+/**
+ * @brief All combinations of GSL, CMAES and NLopt with at least one of them
+ * enabled, in the order the generators iterate them
+ */
+std::vector<int> GetAllMinimizerSettings();
+
+/**
+ * @brief Sets values below the threshold the generators use to zero
+ */
+double ZeroIfSmall(double value);
+
+SettingRecord
+CalcSetting(const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+            int WhichMin,
+            const ReferenceOptions &Options);
+
+std::vector<TripleCouplingEntry> CalcTripleCouplings(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    const ReferenceOptions &Options,
+    StageStatistics *Statistics = nullptr);
+
+/**
+ * @brief Flat representation used to return results from worker processes
+ */
+std::vector<double> PackSetting(const SettingRecord &Setting);
+SettingRecord UnpackSetting(const std::vector<double> &Values);
+std::vector<double>
+PackTripleCouplings(const std::vector<TripleCouplingEntry> &Couplings,
+                    const StageStatistics &Statistics);
+std::vector<TripleCouplingEntry>
+UnpackTripleCouplings(const std::vector<double> &Values,
+                      StageStatistics &Statistics);
+
+/**
+ * @brief Initialises the model with the parameters and calculates all
+ * reference values of the point. The tasks of the point have to be queued in
+ * Options.Metrics by the caller.
+ */
+PointRecord CalcReferencePoint(
+    const std::shared_ptr<BSMPT::Class_Potential_Origin> &modelPointer,
+    std::uint64_t PointID,
+    const std::vector<double> &Parameters,
+    const ReferenceOptions &Options);
+
+} // namespace ReferenceCreator
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Steps of the reference calculation of a single point
+ */
+enum class ReferenceStage
+{
+  EWPT,
+  SymmetricMinimum,
+  Eta,
+  TripleCouplings,
+  MassSpectrum,
+  NumberOfStages
+};
+
+constexpr std::size_t NumberOfReferenceStages =
+    static_cast<std::size_t>(ReferenceStage::NumberOfStages);
+
+/**
+ * @brief Runtime of a stage and the number of BSMPT backend calls it made,
+ * e.g. PTFinder_gen_all or Minimize_gen_all. BSMPT 2.3.3 exposes no count of
+ * the potential evaluations done inside these calls.
+ */
+struct StageStatistics
+{
+  double Seconds{0};
+  std::uint32_t BackendCalls{0};
+};
+
+inline std::string StageName(ReferenceStage stage)
+{
+  switch (stage)
+  {
+  case ReferenceStage::EWPT: return "EWPT";
+  case ReferenceStage::SymmetricMinimum: return "SymmetricMinimum";
+  case ReferenceStage::Eta: return "Eta";
+  case ReferenceStage::TripleCouplings: return "TripleCouplings";
+  case ReferenceStage::MassSpectrum: return "MassSpectrum";
+  default: return "Unknown";
+  }
+}
+
+} // namespace ReferenceCreator
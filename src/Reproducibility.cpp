@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Reproducibility.h"
+
+#include <BSMPT/minimizer/Minimizer.h>
+
+namespace ReferenceCreator
+{
+
+bool UsesCMAES(int WhichMin)
+{
+  for (bool UseGSL : {false, true})
+  {
+    for (bool UseNLopt : {false, true})
+    {
+      if (BSMPT::Minimizer::CalcWhichMinimizer(UseGSL, true, UseNLopt) ==
+          WhichMin)
+        return true;
+    }
+  }
+  return false;
+}
+
+} // namespace ReferenceCreator
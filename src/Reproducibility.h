@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+/**
+ * @file
+ * Labels for results which can differ between otherwise identical runs.
+ */
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief True if the minimizer setting uses CMAES, whose seed is chosen by
+ * libcmaes and not exposed by BSMPT 2.3.3
+ */
+bool UsesCMAES(int WhichMin);
+
+} // namespace ReferenceCreator
@@ -0,0 +1,216 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "RunComparison.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace ReferenceCreator
+{
+
+namespace
+{
+/**
+ * One-sided 99% quantile of the Student t distribution
+ */
+double TCritical(std::size_t DegreesOfFreedom)
+{
+  static const std::vector<double> Table{
+      31.821, 6.965, 4.541, 3.747, 3.365, 3.143, 2.998, 2.896, 2.821, 2.764,
+      2.718,  2.681, 2.650, 2.624, 2.602, 2.583, 2.567, 2.552, 2.539, 2.528,
+      2.518,  2.508, 2.500, 2.492, 2.485, 2.479, 2.473, 2.467, 2.462, 2.457};
+  if (DegreesOfFreedom == 0) return std::numeric_limits<double>::infinity();
+  if (DegreesOfFreedom <= Table.size()) return Table[DegreesOfFreedom - 1];
+  if (DegreesOfFreedom <= 60) return 2.390;
+  if (DegreesOfFreedom <= 120) return 2.358;
+  return 2.326;
+}
+
+std::string KeyToString(const RunReportKey &key)
+{
+  std::stringstream ss;
+  ss << std::get<0>(key) << " point " << std::get<1>(key) << " WhichMin "
+     << std::get<2>(key) << " " << std::get<3>(key);
+  return ss.str();
+}
+
+bool Agree(double a, double b, const ComparisonOptions &Options)
+{
+  if (std::isnan(a) or std::isnan(b)) return std::isnan(a) and std::isnan(b);
+  if (a == b) return true;
+  return std::abs(a - b) <=
+         Options.AbsoluteTolerance +
+             Options.RelativeTolerance * std::max(std::abs(a), std::abs(b));
+}
+} // namespace
+
+bool ComparisonResult::Passed() const
+{
+  if (not Drifts.empty()) return false;
+  for (const auto &el : Stages)
+  {
+    if (el.Regression) return false;
+  }
+  return true;
+}
+
+ComparisonResult CompareRunReports(const RunReport &Baseline,
+                                   const RunReport &Candidate,
+                                   const ComparisonOptions &Options)
+{
+  ComparisonResult result;
+
+  std::map<std::pair<std::string, std::string>, std::vector<double>> LogRatios;
+  std::map<std::pair<std::string, std::string>, StageComparison> stages;
+
+  for (const auto &el : Baseline.Entries)
+  {
+    const auto &base = el.second;
+    const auto it    = Candidate.Entries.find(el.first);
+    const bool Skip  = Options.NonReproducibleRelativeTolerance < 0;
+    if (it == Candidate.Entries.end())
+    {
+      if (Skip and not base.Reproducible)
+        ++result.SkippedNonReproducible;
+      else
+        result.Drifts.push_back({el.first, "missing in the candidate run"});
+      continue;
+    }
+    const auto &cand = it->second;
+
+    const auto group = std::make_pair(base.Model, base.Stage);
+    auto &stage      = stages[group];
+    stage.Model      = base.Model;
+    stage.Stage      = base.Stage;
+    stage.BackendCallsBaseline += base.BackendCalls;
+    stage.BackendCallsCandidate += cand.BackendCalls;
+    if (base.Seconds >= Options.MinSeconds and
+        cand.Seconds >= Options.MinSeconds)
+    {
+      LogRatios[group].push_back(std::log(cand.Seconds / base.Seconds));
+    }
+
+    auto ValueOptions = Options;
+    if (base.Stage == StageName(ReferenceStage::Eta))
+      ValueOptions.AbsoluteTolerance = Options.EtaAbsoluteTolerance;
+    if (not base.Reproducible or not cand.Reproducible)
+    {
+      if (Skip)
+      {
+        ++result.SkippedNonReproducible;
+        continue;
+      }
+      ValueOptions.RelativeTolerance = Options.NonReproducibleRelativeTolerance;
+    }
+
+    if (base.Values.size() != cand.Values.size())
+    {
+      result.Drifts.push_back(
+          {el.first,
+           "number of values changed from " +
+               std::to_string(base.Values.size()) + " to " +
+               std::to_string(cand.Values.size())});
+      continue;
+    }
+    for (std::size_t i{0}; i < base.Values.size(); ++i)
+    {
+      if (Agree(base.Values[i], cand.Values[i], ValueOptions)) continue;
+      std::stringstream ss;
+      ss.precision(std::numeric_limits<double>::max_digits10);
+      ss << "value " << i << " changed from " << base.Values[i] << " to "
+         << cand.Values[i];
+      result.Drifts.push_back({el.first, ss.str()});
+    }
+  }
+
+  for (const auto &el : Candidate.Entries)
+  {
+    if (Baseline.Entries.count(el.first) > 0) continue;
+    if (Options.NonReproducibleRelativeTolerance < 0 and
+        not el.second.Reproducible)
+      ++result.SkippedNonReproducible;
+    else
+      result.Drifts.push_back({el.first, "missing in the baseline run"});
+  }
+
+  for (auto &el : stages)
+  {
+    auto &stage         = el.second;
+    const auto &samples = LogRatios[el.first];
+    stage.Samples       = samples.size();
+    if (samples.empty())
+    {
+      result.Stages.push_back(stage);
+      continue;
+    }
+
+    double mean{0};
+    for (const auto &x : samples)
+      mean += x;
+    mean /= samples.size();
+    double variance{0};
+    for (const auto &x : samples)
+      variance += (x - mean) * (x - mean);
+    if (samples.size() > 1) variance /= samples.size() - 1;
+
+    stage.Ratio     = std::exp(mean);
+    stage.TCritical = TCritical(samples.size() - 1);
+    if (variance > 0)
+    {
+      stage.TStatistic = mean / std::sqrt(variance / samples.size());
+    }
+    else
+    {
+      stage.TStatistic = (mean > 0) ? std::numeric_limits<double>::infinity()
+                                    : 0;
+    }
+    stage.Regression = samples.size() >= Options.MinSamples and
+                       stage.Ratio > 1 + Options.MaxSlowdown and
+                       stage.TStatistic > stage.TCritical;
+    result.Stages.push_back(stage);
+  }
+
+  return result;
+}
+
+void PrintComparison(std::ostream &out, const ComparisonResult &Result)
+{
+  out << std::left << std::setw(14) << "Model" << std::setw(18) << "Stage"
+      << std::right << std::setw(8) << "Samples" << std::setw(10) << "Ratio"
+      << std::setw(10) << "t" << std::setw(10) << "t_crit" << std::setw(12)
+      << "Calls old" << std::setw(12) << "Calls new"
+      << "\n";
+  for (const auto &el : Result.Stages)
+  {
+    out << std::left << std::setw(14) << el.Model << std::setw(18) << el.Stage
+        << std::right << std::setw(8) << el.Samples << std::setw(10)
+        << std::setprecision(4) << el.Ratio << std::setw(10) << el.TStatistic
+        << std::setw(10) << el.TCritical << std::setw(12)
+        << el.BackendCallsBaseline << std::setw(12) << el.BackendCallsCandidate
+        << (el.Regression ? "  SLOWDOWN" : "") << "\n";
+  }
+
+  if (not Result.Drifts.empty())
+  {
+    out << "\nNumeric drifts beyond tolerance:\n";
+    for (const auto &el : Result.Drifts)
+      out << "  " << KeyToString(el.Key) << ": " << el.Description << "\n";
+  }
+
+  if (Result.SkippedNonReproducible > 0)
+  {
+    out << "\n"
+        << Result.SkippedNonReproducible
+        << " entries depending on CMAES were not compared\n";
+  }
+
+  out << "\n" << (Result.Passed() ? "PASSED" : "FAILED") << std::endl;
+}
+
+} // namespace ReferenceCreator
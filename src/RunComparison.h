@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "RunReport.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ReferenceCreator
+{
+
+struct ComparisonOptions
+{
+  /// Relative slowdown of a stage which is reported as regression
+  double MaxSlowdown{0.1};
+  /// Values differing by more than Absolute + Relative * max(|a|, |b|) drift
+  double AbsoluteTolerance{1e-8};
+  double RelativeTolerance{1e-6};
+  /// Replaces AbsoluteTolerance for the Eta stage, whose values of order
+  /// 1e-11 would otherwise always agree. 0 compares them only relatively.
+  double EtaAbsoluteTolerance{0};
+  /// Relative tolerance of entries not marked as reproducible, e.g. CMAES
+  /// settings. Negative values skip their values and missing entries.
+  double NonReproducibleRelativeTolerance{-1};
+  /// Timings below are dominated by noise and are not compared
+  double MinSeconds{1e-4};
+  /// Minimal number of paired timings for the significance test
+  std::size_t MinSamples{3};
+};
+
+/**
+ * @brief Timing comparison of one stage of a model over all points and
+ * settings present in both reports. The runtimes are compared pairwise by
+ * their log ratio, a one-sided t-test at 99% confidence decides whether the
+ * slowdown is significant.
+ */
+struct StageComparison
+{
+  std::string Model;
+  std::string Stage;
+  std::size_t Samples{0};
+  /// Geometric mean of candidate / baseline runtime
+  double Ratio{1};
+  double TStatistic{0};
+  double TCritical{0};
+  std::uint64_t BackendCallsBaseline{0};
+  std::uint64_t BackendCallsCandidate{0};
+  bool Regression{false};
+};
+
+struct ValueDrift
+{
+  RunReportKey Key;
+  std::string Description;
+};
+
+struct ComparisonResult
+{
+  std::vector<StageComparison> Stages;
+  std::vector<ValueDrift> Drifts;
+  /// Entries not marked as reproducible whose values were not compared
+  std::size_t SkippedNonReproducible{0};
+
+  bool Passed() const;
+};
+
+ComparisonResult CompareRunReports(const RunReport &Baseline,
+                                   const RunReport &Candidate,
+                                   const ComparisonOptions &Options);
+
+void PrintComparison(std::ostream &out, const ComparisonResult &Result);
+
+} // namespace ReferenceCreator
@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "RunReport.h"
+
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace ReferenceCreator
+{
+
+std::string GetBSMPTVersion()
+{
+#ifdef BSMPT_REFERENCE_BSMPT_VERSION
+  return BSMPT_REFERENCE_BSMPT_VERSION;
+#else
+  return "unknown";
+#endif
+}
+
+RunReportWriter::RunReportWriter(const std::string &FileName,
+                                 const std::string &Model)
+    : mFile(FileName, std::ios::trunc)
+    , mModel(Model)
+{
+  if (not mFile.good())
+  {
+    throw std::runtime_error("RunReport: can not open " + FileName +
+                             " for writing");
+  }
+  mFile << "# bsmpt_version " << GetBSMPTVersion() << "\n"
+        << "# model " << mModel << "\n";
+  mFile.precision(std::numeric_limits<double>::max_digits10);
+}
+
+void RunReportWriter::Write(const RunReportEntry &Entry)
+{
+  mFile << Entry.Model << " " << Entry.PointID << " " << Entry.WhichMin << " "
+        << Entry.Stage << " " << Entry.Seconds << " " << Entry.BackendCalls
+        << " " << Entry.Reproducible << " " << Entry.Values.size();
+  for (const auto &el : Entry.Values)
+    mFile << " " << el;
+  mFile << "\n";
+}
+
+void RunReportWriter::Add(const PointRecord &Point)
+{
+  RunReportEntry entry;
+  entry.Model   = mModel;
+  entry.PointID = Point.PointID;
+
+  auto SetStatistics = [&](ReferenceStage stage, const StageStatistics &stats)
+  {
+    entry.Stage        = StageName(stage);
+    entry.Seconds      = stats.Seconds;
+    entry.BackendCalls = stats.BackendCalls;
+  };
+
+  for (const auto &setting : Point.Settings)
+  {
+    entry.WhichMin     = setting.WhichMin;
+    entry.Reproducible = setting.Reproducible;
+    const auto &stats  = setting.Statistics;
+
+    SetStatistics(ReferenceStage::EWPT,
+                  stats[static_cast<std::size_t>(ReferenceStage::EWPT)]);
+    entry.Values = {
+        static_cast<double>(setting.StatusFlag), setting.Tc, setting.vc};
+    entry.Values.insert(
+        entry.Values.end(), setting.EWMinimum.begin(), setting.EWMinimum.end());
+    Write(entry);
+
+    SetStatistics(
+        ReferenceStage::SymmetricMinimum,
+        stats[static_cast<std::size_t>(ReferenceStage::SymmetricMinimum)]);
+    entry.Values = setting.vevSymmetric;
+    Write(entry);
+
+    SetStatistics(ReferenceStage::Eta,
+                  stats[static_cast<std::size_t>(ReferenceStage::Eta)]);
+    if (entry.BackendCalls > 0)
+    {
+      entry.Values = {setting.LW};
+      entry.Values.insert(
+          entry.Values.end(), setting.eta.begin(), setting.eta.end());
+      Write(entry);
+    }
+
+    SetStatistics(
+        ReferenceStage::MassSpectrum,
+        stats[static_cast<std::size_t>(ReferenceStage::MassSpectrum)]);
+    if (entry.BackendCalls > 0)
+    {
+      const auto &table = setting.MassSpectrum;
+      entry.Values      = table.Temperatures;
+      entry.Values.insert(
+          entry.Values.end(), table.Data.begin(), table.Data.end());
+      Write(entry);
+    }
+  }
+
+  entry.WhichMin     = 0;
+  entry.Reproducible = true;
+  SetStatistics(ReferenceStage::TripleCouplings,
+                Point.TripleCouplingsStatistics);
+  entry.Values.clear();
+  for (const auto &el : Point.TripleCouplings)
+  {
+    entry.Values.insert(entry.Values.end(),
+                        {static_cast<double>(el.i),
+                         static_cast<double>(el.j),
+                         static_cast<double>(el.k),
+                         el.Tree,
+                         el.CT,
+                         el.CW});
+  }
+  Write(entry);
+  mFile.flush();
+}
+
+RunReport ReadRunReport(const std::string &FileName)
+{
+  std::ifstream input(FileName);
+  if (not input.good())
+    throw std::runtime_error("RunReport: can not open " + FileName);
+
+  RunReport result;
+  std::string linestr;
+  std::size_t LineNumber{0};
+  while (std::getline(input, linestr))
+  {
+    ++LineNumber;
+    if (linestr.empty()) continue;
+    std::stringstream ss(linestr);
+    if (linestr.front() == '#')
+    {
+      std::string hash, key, value;
+      ss >> hash >> key;
+      std::getline(ss >> std::ws, value);
+      result.Header[key] = value;
+      continue;
+    }
+
+    RunReportEntry entry;
+    std::size_t size;
+    ss >> entry.Model >> entry.PointID >> entry.WhichMin >> entry.Stage >>
+        entry.Seconds >> entry.BackendCalls >> entry.Reproducible >> size;
+    // Values are parsed with stod, as operator>> does not accept nan and inf
+    std::string value;
+    while (not ss.fail() and entry.Values.size() < size and ss >> value)
+      entry.Values.push_back(std::stod(value));
+    if (ss.fail() or entry.Values.size() != size)
+    {
+      throw std::runtime_error("RunReport: invalid line " +
+                               std::to_string(LineNumber) + " in " + FileName);
+    }
+    const RunReportKey key{
+        entry.Model, entry.PointID, entry.WhichMin, entry.Stage};
+    result.Entries[key] = entry;
+  }
+  return result;
+}
+
+} // namespace ReferenceCreator
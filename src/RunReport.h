@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "ReferenceArchive.h"
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * @file
+ * Text report of a run with the runtime, the number of backend calls and the
+ * calculated values of every (point, WhichMin, stage). The mass spectrum
+ * entry holds the temperatures followed by the rows of the table. Reports of
+ * runs with different BSMPT versions are compared by CompareRuns.
+ *
+ * Lines starting with # hold header information as key and value, every other
+ * line one entry:
+ * Model PointID WhichMin Stage Seconds BackendCalls Reproducible
+ * NumberOfValues Values...
+ * Reproducible is 0 for entries depending on CMAES, which can differ between
+ * runs.
+ */
+
+namespace ReferenceCreator
+{
+
+struct RunReportEntry
+{
+  std::string Model;
+  std::uint64_t PointID{0};
+  int WhichMin{0};
+  std::string Stage;
+  double Seconds{0};
+  std::uint64_t BackendCalls{0};
+  bool Reproducible{true};
+  std::vector<double> Values;
+};
+
+using RunReportKey = std::tuple<std::string, std::uint64_t, int, std::string>;
+
+struct RunReport
+{
+  std::map<std::string, std::string> Header;
+  std::map<RunReportKey, RunReportEntry> Entries;
+};
+
+/**
+ * @brief BSMPT version the ReferenceCreator was built against
+ */
+std::string GetBSMPTVersion();
+
+class RunReportWriter
+{
+public:
+  RunReportWriter(const std::string &FileName, const std::string &Model);
+
+  /**
+   * @brief Writes one entry per stage of the point
+   */
+  void Add(const PointRecord &Point);
+
+private:
+  void Write(const RunReportEntry &Entry);
+
+  std::ofstream mFile;
+  std::string mModel;
+};
+
+RunReport ReadRunReport(const std::string &FileName);
+
+} // namespace ReferenceCreator
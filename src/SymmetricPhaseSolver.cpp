@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SymmetricPhaseSolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <BSMPT/minimizer/Minimizer.h>
+
+namespace ReferenceCreator
+{
+
+SymmetricPhaseSolver::SymmetricPhaseSolver(
+    std::shared_ptr<BSMPT::Class_Potential_Origin> modelPointer,
+    double TemperatureTolerance,
+    double VevTolerance,
+    double WarmStartRadius)
+    : mModelPointer(std::move(modelPointer))
+    , mTemperatureTolerance(TemperatureTolerance)
+    , mVevTolerance(VevTolerance)
+    , mWarmStartRadius(WarmStartRadius)
+{
+}
+
+SymmetricSolution
+SymmetricPhaseSolver::Solve(double Tc,
+                            const std::vector<double> &EWMinimum,
+                            int WhichMin)
+{
+  // Distance in units of the tolerances, the input agrees for values <= 1,
+  // and the largest difference in GeV for the warm start
+  const Solution *closest{nullptr};
+  double ClosestDistance   = std::numeric_limits<double>::infinity();
+  double ClosestDifference = std::numeric_limits<double>::infinity();
+  const bool HasTransition = Tc > 0;
+  for (const auto &solution : mSolutions)
+  {
+    if (not HasTransition) break;
+    if (solution.EWMinimum.size() != EWMinimum.size()) continue;
+    double difference = std::abs(solution.Tc - Tc);
+    double distance   = difference / mTemperatureTolerance;
+    for (std::size_t i{0}; i < EWMinimum.size(); ++i)
+    {
+      const auto diff = std::abs(solution.EWMinimum[i] - EWMinimum[i]);
+      difference      = std::max(difference, diff);
+      distance        = std::max(distance, diff / mVevTolerance);
+    }
+    if (distance < ClosestDistance)
+    {
+      ClosestDistance   = distance;
+      ClosestDifference = difference;
+      closest           = &solution;
+    }
+  }
+
+  if (closest != nullptr and ClosestDistance <= 1) return closest->Result;
+
+  std::vector<double> checksym, startpoint;
+  if (closest != nullptr and ClosestDifference <= mWarmStartRadius)
+  {
+    startpoint = closest->Result.Minimum;
+  }
+  else
+  {
+    for (const auto &el : EWMinimum)
+      startpoint.push_back(0.5 * el);
+  }
+
+  SymmetricSolution result;
+  result.SolvedWith = WhichMin;
+  result.Minimum    = BSMPT::Minimizer::Minimize_gen_all(
+      mModelPointer, Tc + 1, checksym, startpoint, WhichMin, true);
+  ++mMinimizations;
+  if (HasTransition) mSolutions.push_back(Solution{Tc, EWMinimum, result});
+  return result;
+}
+
+} // namespace ReferenceCreator
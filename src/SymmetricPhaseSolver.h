@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2021 Philipp Basler
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <BSMPT/models/ClassPotentialOrigin.h>
+
+namespace ReferenceCreator
+{
+
+/**
+ * @brief Minimum of the symmetric phase at Tc + 1, shared between the
+ * minimizer settings of a point.
+ *
+ * The settings of a point usually find nearly the same Tc and EWMinimum, so
+ * the symmetric phase is only minimized once for inputs agreeing within the
+ * tolerances. A shared minimum was then found by the minimizer of the setting
+ * solved first, which is returned as SolvedWith. Other inputs are minimized
+ * with their own minimizer, starting from the solution of the closest input
+ * within WarmStartRadius instead of 0.5 * EWMinimum. Inputs without a phase
+ * transition (Tc <= 0) are neither shared nor used as a starting point.
+ */
+struct SymmetricSolution
+{
+  std::vector<double> Minimum;
+  /// WhichMin of the minimization that found Minimum
+  int SolvedWith{0};
+};
+
+class SymmetricPhaseSolver
+{
+public:
+  /**
+   * @param TemperatureTolerance maximal difference in Tc in GeV
+   * @param VevTolerance maximal difference of each EWMinimum entry in GeV
+   * @param WarmStartRadius maximal difference in Tc and each EWMinimum entry
+   * in GeV for a solution to be used as starting point
+   */
+  explicit SymmetricPhaseSolver(
+      std::shared_ptr<BSMPT::Class_Potential_Origin> modelPointer,
+      double TemperatureTolerance = 1e-3,
+      double VevTolerance         = 1e-3,
+      double WarmStartRadius      = 10);
+
+  /**
+   * @brief Symmetric minimum for the phase transition found with WhichMin
+   */
+  SymmetricSolution
+  Solve(double Tc, const std::vector<double> &EWMinimum, int WhichMin);
+
+  /**
+   * @brief Forgets all solutions, has to be called if the model parameters
+   * change
+   */
+  void Clear() { mSolutions.clear(); }
+
+  std::size_t NumberOfMinimizations() const { return mMinimizations; }
+
+private:
+  struct Solution
+  {
+    double Tc;
+    std::vector<double> EWMinimum;
+    SymmetricSolution Result;
+  };
+
+  std::shared_ptr<BSMPT::Class_Potential_Origin> mModelPointer;
+  double mTemperatureTolerance;
+  double mVevTolerance;
+  double mWarmStartRadius;
+  std::vector<Solution> mSolutions;
+  std::size_t mMinimizations{0};
+};
+
+} // namespace ReferenceCreator